@@ -1,4 +1,7 @@
 #include "ASTConsumer.h"
+#include "AttrParser.h"
+#include "PerfectHash.h"
+#include "hash.h"
 #include "meta.h"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/ASTContext.h"
@@ -11,10 +14,15 @@
 #include "clang/AST/RecursiveASTVisitor.h"
 #include "clang/AST/Type.h"
 #include "clang/Basic/SourceManager.h"
+#include "clang/Index/USRGeneration.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/bit.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/xxhash.h"
+#include <algorithm>
 #include <vector>
 
 namespace help {
@@ -45,6 +53,67 @@ std::string get_raw_type_name(clang::QualType type, clang::ASTContext *ctx) {
   str_remove_all(baseName, "class ");
   return baseName;
 }
+std::string get_usr(const clang::Decl *decl) {
+  llvm::SmallString<128> usr;
+  if (clang::index::generateUSRForDecl(decl, usr))
+    return {};
+  return usr.str().str();
+}
+uint64_t get_id(llvm::StringRef usr) {
+  return usr.empty() ? 0 : llvm::xxh3_64bits(usr);
+}
+uint64_t get_type_id(clang::QualType type, clang::ASTContext *ctx) {
+  // same type as get_raw_type_name, so it links to the id of record or enum
+  if (type->isPointerType() || type->isReferenceType())
+    type = type->getPointeeType();
+  type = type.getCanonicalType().getUnqualifiedType();
+  if (auto tag_decl = type->getAsTagDecl())
+    return get_id(get_usr(tag_decl));
+  llvm::SmallString<128> usr;
+  if (clang::index::generateUSRForType(type, *ctx, usr))
+    return 0;
+  return get_id(usr);
+}
+uint64_t get_type_hash(clang::QualType type, clang::ASTContext *ctx) {
+  if (type->isPointerType() || type->isReferenceType())
+    type = type->getPointeeType();
+  return meta::fnv1a_64(get_type_name(type.getUnqualifiedType(), ctx));
+}
+void fill_enum_shape(meta::Enum &enum_data) {
+  if (enum_data.values.empty())
+    return;
+
+  // order signed values as unsigned by flipping sign bit
+  auto order_key = [&](int64_t value) {
+    return enum_data.is_signed ? uint64_t(value) ^ (uint64_t(1) << 63) : uint64_t(value);
+  };
+  std::vector<int64_t> values;
+  for (auto &value : enum_data.values) {
+    values.push_back(value.value);
+  }
+  std::sort(values.begin(), values.end(), [&](int64_t a, int64_t b) { return order_key(a) < order_key(b); });
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+
+  // range
+  enum_data.min_value = values.front();
+  enum_data.max_value = values.back();
+  enum_data.is_contiguous = order_key(values.back()) - order_key(values.front()) == values.size() - 1;
+
+  // flags
+  uint64_t single_bits = 0;
+  size_t single_bit_count = 0;
+  for (auto value : values) {
+    if (enum_data.is_signed && value < 0)
+      return;
+    if (llvm::has_single_bit(uint64_t(value))) {
+      single_bits |= uint64_t(value);
+      ++single_bit_count;
+    }
+  }
+  enum_data.is_flags = single_bit_count >= 2 && std::all_of(values.begin(), values.end(), [&](int64_t value) {
+                         return (uint64_t(value) & ~single_bits) == 0;
+                       });
+}
 std::string get_access_string(clang::AccessSpecifier access) {
   switch (access) {
   case clang::AS_public:
@@ -76,17 +145,46 @@ std::string relative_path(const llvm::StringRef &root, const llvm::StringRef &pa
     return {};
   return path.substr(root.size()).str();
 }
-std::vector<std::string> parse_attr(clang::NamedDecl *decl) {
+// without a filter every annotation except the reflect flag is an attr
+bool is_attr_exported(const meta::ReflectFilter *filter, llvm::StringRef annotation) {
+  return filter ? filter->is_attr_exported(annotation) : annotation != "__reflect__";
+}
+std::vector<std::string> parse_attr(clang::NamedDecl *decl, const meta::ReflectFilter *filter = nullptr) {
   std::vector<std::string> attrs;
   for (auto annotate : decl->specific_attrs<clang::AnnotateAttr>()) {
     auto text = annotate->getAnnotation();
-    if (text == "__reflect__") {
+    if (!is_attr_exported(filter, text)) {
       continue;
     }
     attrs.push_back(text.str());
   }
   return attrs;
 };
+// annotate attribute argument, constants are evaluated, others keep their spelling
+llvm::json::Value annotate_arg_value(clang::Expr *expr, clang::ASTContext *ctx) {
+  expr = expr->IgnoreParenImpCasts();
+  if (auto str = llvm::dyn_cast<clang::StringLiteral>(expr); str && str->getCharByteWidth() == 1)
+    return str->getString().str();
+  clang::Expr::EvalResult result;
+  if (!expr->isValueDependent() && expr->EvaluateAsRValue(result, *ctx)) {
+    if (result.Val.isInt() && expr->getType()->isBooleanType())
+      return result.Val.getInt().getBoolValue();
+    if (result.Val.isInt() && result.Val.getInt().isSigned())
+      return result.Val.getInt().getSExtValue();
+    if (result.Val.isInt())
+      return result.Val.getInt().getZExtValue();
+    if (result.Val.isFloat()) {
+      bool loses_info = false;
+      auto value = result.Val.getFloat();
+      value.convert(llvm::APFloat::IEEEdouble(), llvm::APFloat::rmNearestTiesToEven, &loses_info);
+      return value.convertToDouble();
+    }
+  }
+  std::string spelling;
+  llvm::raw_string_ostream os(spelling);
+  expr->printPretty(os, nullptr, ctx->getPrintingPolicy());
+  return os.str();
+}
 bool has_reflect_flag(clang::NamedDecl *decl) {
   for (auto annotate : decl->specific_attrs<clang::AnnotateAttr>()) {
     auto text = annotate->getAnnotation();
@@ -105,6 +203,84 @@ std::string get_decl_file_name(clang::Decl *decl, const clang::PresumedLoc &loca
     return "";
   }
 }
+// canonical type without locations of unnamed types, which change with lines
+std::string get_structure_type_name(clang::QualType type, clang::ASTContext *ctx) {
+  clang::PrintingPolicy policy(ctx->getLangOpts());
+  policy.AnonymousTagLocations = false;
+  return type.getCanonicalType().getAsString(policy);
+}
+// input of structural_hash, items are tagged and length prefixed so adjacent ones cannot merge
+void add_structure_item(std::string &text, llvm::StringRef tag, llvm::StringRef value) {
+  text += tag;
+  text += ':';
+  text += std::to_string(value.size());
+  text += ':';
+  text += value;
+}
+void add_structure_annotations(std::string &text, clang::Decl *decl, const meta::ReflectFilter *filter, clang::ASTContext *ctx) {
+  for (auto annotate : decl->specific_attrs<clang::AnnotateAttr>()) {
+    auto annotation = annotate->getAnnotation();
+    if (!is_attr_exported(filter, annotation))
+      continue;
+    add_structure_item(text, "attr", annotation);
+    for (auto arg : annotate->args()) {
+      std::string value;
+      llvm::raw_string_ostream os(value);
+      os << annotate_arg_value(arg, ctx);
+      add_structure_item(text, "arg", os.str());
+    }
+  }
+}
+// size, alignment and fields in order, fields of unnamed record type are added in place
+void add_structure_fields(std::string &text, clang::RecordDecl *record_decl, const meta::ReflectFilter *filter, clang::ASTContext *ctx) {
+  const clang::ASTRecordLayout *layout = nullptr;
+  if (!record_decl->isDependentType() && record_decl->isCompleteDefinition() && !record_decl->isInvalidDecl()) {
+    layout = &ctx->getASTRecordLayout(record_decl);
+    add_structure_item(text, "size", std::to_string(layout->getSize().getQuantity()));
+    add_structure_item(text, "align", std::to_string(layout->getAlignment().getQuantity()));
+  }
+  for (auto field : record_decl->fields()) {
+    add_structure_item(text, "field", field->getName());
+    add_structure_item(text, "type", get_structure_type_name(field->getType(), ctx));
+    add_structure_item(text, "access", get_access_string(field->getAccess()));
+    if (field->isBitField() && !field->getBitWidth()->isValueDependent())
+      add_structure_item(text, "bits", std::to_string(field->getBitWidthValue(*ctx)));
+    if (layout)
+      add_structure_item(text, "offset", std::to_string(layout->getFieldOffset(field->getFieldIndex())));
+    add_structure_annotations(text, field, filter, ctx);
+
+    auto field_record = ctx->getBaseElementType(field->getType())->getAsRecordDecl();
+    if (field_record && field_record->getDeclName().isEmpty() && !field_record->getTypedefNameForAnonDecl()) {
+      add_structure_item(text, "unnamed", "{");
+      add_structure_fields(text, field_record, filter, ctx);
+      add_structure_item(text, "unnamed", "}");
+    }
+  }
+}
+uint64_t get_record_structural_hash(clang::CXXRecordDecl *record_decl, clang::ASTContext *ctx, const meta::ReflectFilter *filter) {
+  std::string text;
+  add_structure_annotations(text, record_decl, filter, ctx);
+  for (auto base : record_decl->bases()) {
+    add_structure_item(text, base.isVirtual() ? "virtual_base" : "base", get_structure_type_name(base.getType(), ctx));
+    add_structure_item(text, "access", get_access_string(base.getAccessSpecifier()));
+  }
+  add_structure_fields(text, record_decl, filter, ctx);
+  return llvm::xxh3_64bits(text);
+}
+uint64_t get_enum_structural_hash(clang::EnumDecl *enum_decl, clang::ASTContext *ctx, const meta::ReflectFilter *filter) {
+  std::string text;
+  add_structure_annotations(text, enum_decl, filter, ctx);
+  add_structure_item(text, "scoped", enum_decl->isScoped() ? "true" : "false");
+  auto integer_type = enum_decl->getIntegerType();
+  if (!integer_type.isNull())
+    add_structure_item(text, "underlying", get_structure_type_name(integer_type, ctx));
+  for (auto enumerator : enum_decl->enumerators()) {
+    add_structure_item(text, "value", enumerator->getName());
+    add_structure_item(text, "init", llvm::toString(enumerator->getInitVal(), 10));
+    add_structure_annotations(text, enumerator, filter, ctx);
+  }
+  return llvm::xxh3_64bits(text);
+}
 } // namespace help
 
 class ParmVisitor : public clang::RecursiveASTVisitor<ParmVisitor> {
@@ -124,7 +300,8 @@ public:
     meta::Field param_data;
 
     // comment & location
-    param_data.comment = help::get_comment(param_decl, consumer->transition_unit_ctx(), consumer->transition_unit_ctx()->getSourceManager());
+    if (consumer->_has_key("Field", "comment"))
+      param_data.comment = help::get_comment(param_decl, consumer->transition_unit_ctx(), consumer->transition_unit_ctx()->getSourceManager());
     param_data.line = consumer->transition_unit_ctx()->getSourceManager().getPresumedLineNumber(param_decl->getLocation());
 
     // parse parameter data
@@ -133,22 +310,16 @@ public:
       param_data.name = "unnamed" + std::to_string(param_decl->getFunctionScopeIndex());
       param_data.is_anonymous = true;
     }
-    param_data.attrs = help::parse_attr(param_decl);
-
-    // parse array data
-    if (param_decl->getType()->isConstantArrayType()) {
-      auto ftype = llvm::dyn_cast<clang::ConstantArrayType>(param_decl->getType());
-      param_data.array_size = ftype->getSize().getZExtValue();
-      param_data.type = help::get_type_name(ftype->getElementType(), consumer->transition_unit_ctx());
-      param_data.raw_type = help::get_raw_type_name(ftype->getElementType(), consumer->transition_unit_ctx());
-    } else {
-      param_data.array_size = 0;
-      param_data.type = help::get_type_name(param_decl->getType(), consumer->transition_unit_ctx());
-      param_data.raw_type = help::get_raw_type_name(param_decl->getType(), consumer->transition_unit_ctx());
-    }
+    if (consumer->_has_key("Field", "attrs"))
+      param_data.attrs = consumer->_parse_attr(param_decl);
+    if (consumer->_has_key("Field", "attributes"))
+      param_data.attributes = consumer->_parse_attributes(param_decl);
+
+    // parse type & array data
+    consumer->_fill_field_type(param_decl->getType(), param_data);
 
     // recursive handle function pointer
-    consumer->_fill_function_pointer(param_decl, param_data);
+    consumer->_fill_function_pointer(param_decl, param_data, *db);
 
     // parameter unused data
     param_data.access = help::get_access_string(clang::AS_none);
@@ -162,6 +333,7 @@ public:
 
   // input
   meta::ASTConsumer *consumer; // 用于获取 transition unit 和 递归调用
+  meta::Database *db;          // 回调参数的签名写入的数据库
   clang::Decl *root_decl;      // 根部的 decl, 用于避免重复访问根节点（作为函数参数时）
 
   std::vector<meta::Field> parameters; // 填充的参数列表
@@ -169,8 +341,9 @@ public:
 };
 
 namespace meta {
-ASTConsumer::ASTConsumer(FileDataMap &datamap, std::string root)
-    : _datamap(datamap) {
+ASTConsumer::ASTConsumer(FileDataMap &datamap, std::string root, LayoutReport *layout_report,
+                         const ReflectFilter *filter, const OutputSchema *schema)
+    : _datamap(datamap), _layout_report(layout_report), _filter(filter), _schema(schema) {
   _root = llvm::sys::path::convert_to_slash(root);
 }
 
@@ -213,6 +386,10 @@ void ASTConsumer::handle_namespace(clang::NamedDecl *decl) {
   if (decl->isInvalidDecl())
     return;
 
+  // filter excluded namespace
+  if (_filter && _filter->is_namespace_excluded(llvm::cast<clang::NamespaceDecl>(decl)))
+    return;
+
   // each child decl
   clang::DeclContext *decl_ctx = decl->castToDeclContext(decl);
   for (auto decl_it = decl_ctx->decls_begin(); decl_it != decl_ctx->decls_end(); ++decl_it) {
@@ -245,6 +422,10 @@ void ASTConsumer::handle_record(clang::NamedDecl *decl) {
   if (decl->isInvalidDecl())
     return;
 
+  // filter namespace
+  if (!_filter_namespace(decl))
+    return;
+
   // filter location
   clang::SourceManager &source_manager = _transition_unit_ctx->getSourceManager();
   clang::PresumedLoc location = source_manager.getPresumedLoc(decl->getLocation());
@@ -312,57 +493,88 @@ void ASTConsumer::handle_record(clang::NamedDecl *decl) {
   Record record_data = {};
 
   // parse comment & location
-  record_data.comment = help::get_comment(record_decl, _transition_unit_ctx, source_manager);
+  if (_has_key("Record", "comment"))
+    record_data.comment = help::get_comment(record_decl, _transition_unit_ctx, source_manager);
   record_data.file_name = abs_file_name;
   record_data.line = line;
 
   // parse record data
   record_data.name = record_decl->getQualifiedNameAsString();
-  record_data.attrs = help::parse_attr(record_decl);
+  record_data.usr = help::get_usr(record_decl);
+  record_data.id = help::get_id(record_data.usr);
+  if (_has_key("Record", "type_hash"))
+    record_data.type_hash = help::get_type_hash(_transition_unit_ctx->getTypeDeclType(record_decl), _transition_unit_ctx);
+  if (_has_key("Record", "attrs"))
+    record_data.attrs = _parse_attr(record_decl);
+  if (_has_key("Record", "attributes"))
+    record_data.attributes = _parse_attributes(record_decl);
+  if (_has_key("Record", "structural_hash"))
+    record_data.structural_hash = help::get_record_structural_hash(record_decl, _transition_unit_ctx, _filter);
   for (auto base : record_decl->bases()) {
-    record_data.bases.push_back(help::get_type_name(base.getType(), _transition_unit_ctx));
+    if (_has_key("Record", "bases"))
+      record_data.bases.push_back(help::get_type_name(base.getType(), _transition_unit_ctx));
+    if (_has_key("Record", "base_ids"))
+      record_data.base_ids.push_back(help::get_type_id(base.getType(), _transition_unit_ctx));
+    if (_has_key("Record", "base_hashes"))
+      record_data.base_hashes.push_back(help::get_type_hash(base.getType(), _transition_unit_ctx));
     // TODO. base info
     base.isVirtual();
     base.getAccessSpecifier();
   }
 
-  // dispatch child decl
+  // dispatch child decl, members dropped by schema are not parsed
+  std::vector<Field> fields;
+  std::vector<Function> methods;
+  std::vector<Constructor> ctors;
+  bool need_fields = _has_key("Record", "fields") || _has_key("Record", "field_hash");
+  bool need_methods = _has_key("Record", "methods");
+  bool need_ctors = _has_key("Record", "ctors");
   for (auto child_decl : decl->castToDeclContext(decl)->decls()) {
     auto named_child_decl = llvm::dyn_cast<clang::NamedDecl>(child_decl);
     if (named_child_decl) {
       switch (named_child_decl->getKind()) {
       case (clang::Decl::Field): {
-        auto result = handle_field(named_child_decl);
+        if (!need_fields)
+          break;
+        auto result = handle_field(named_child_decl, db);
         if (result) {
-          record_data.fields.push_back(std::move(result.value()));
+          fields.push_back(std::move(result.value()));
         }
         break;
       }
       case (clang::Decl::Var): {
-        auto result = handle_static_field(named_child_decl);
+        if (!need_fields)
+          break;
+        auto result = handle_static_field(named_child_decl, db);
         if (result) {
-          record_data.fields.push_back(std::move(result.value()));
+          fields.push_back(std::move(result.value()));
         }
         break;
       }
       case (clang::Decl::CXXMethod): {
-        auto result = handle_method(named_child_decl);
+        if (!need_methods)
+          break;
+        auto result = handle_method(named_child_decl, db);
         if (result) {
-          record_data.methods.emplace_back(std::move(result.value()));
+          methods.emplace_back(std::move(result.value()));
         }
         break;
       }
       case (clang::Decl::Function): {
-        auto result = handle_static_method(named_child_decl);
+        if (!need_methods)
+          break;
+        auto result = handle_static_method(named_child_decl, db);
         if (result) {
-          record_data.methods.emplace_back(std::move(result.value()));
+          methods.emplace_back(std::move(result.value()));
         }
         break;
       }
       case (clang::Decl::CXXConstructor): {
-        auto result = handle_constructor(named_child_decl);
+        if (!need_ctors)
+          break;
+        auto result = handle_constructor(named_child_decl, db);
         if (result) {
-          record_data.ctors.emplace_back(std::move(result.value()));
+          ctors.emplace_back(std::move(result.value()));
         }
         break;
       }
@@ -375,14 +587,35 @@ void ASTConsumer::handle_record(clang::NamedDecl *decl) {
     }
   }
 
+  // layout report
+  if (_layout_report) {
+    _layout_report->add_record(record_decl, *_transition_unit_ctx, abs_file_name, line);
+  }
+
+  // name lookup table
+  if (_has_key("Record", "field_hash")) {
+    std::vector<std::string> names;
+    for (auto &field : fields) {
+      names.push_back(field.name);
+    }
+    record_data.field_hash = build_perfect_hash(names);
+  }
+
   // push record
-  _get_file_db(rel_file_name).records.emplace_back(std::move(record_data));
+  record_data.fields = Database::add_rows(db.fields, std::move(fields));
+  record_data.methods = Database::add_rows(db.methods, std::move(methods));
+  record_data.ctors = Database::add_rows(db.ctors, std::move(ctors));
+  db.records.emplace_back(std::move(record_data));
 }
 void ASTConsumer::handle_enum(clang::NamedDecl *decl) {
   // filter invalid decl
   if (decl->isInvalidDecl())
     return;
 
+  // filter namespace
+  if (!_filter_namespace(decl))
+    return;
+
   // filter location
   clang::SourceManager &source_manager = _transition_unit_ctx->getSourceManager();
   clang::PresumedLoc location = source_manager.getPresumedLoc(decl->getLocation());
@@ -417,34 +650,68 @@ void ASTConsumer::handle_enum(clang::NamedDecl *decl) {
   Enum enum_data;
 
   // parse comment & location
-  enum_data.comment = help::get_comment(enum_decl, _transition_unit_ctx, source_manager);
+  if (_has_key("Enum", "comment"))
+    enum_data.comment = help::get_comment(enum_decl, _transition_unit_ctx, source_manager);
   enum_data.file_name = abs_file_name;
   enum_data.line = line;
 
   // parse enum data
   enum_data.name = enum_decl->getQualifiedNameAsString();
+  enum_data.usr = help::get_usr(enum_decl);
+  enum_data.id = help::get_id(enum_data.usr);
+  if (_has_key("Enum", "type_hash"))
+    enum_data.type_hash = help::get_type_hash(_transition_unit_ctx->getTypeDeclType(enum_decl), _transition_unit_ctx);
   enum_data.is_scoped = enum_decl->isScoped();
-  enum_data.underlying_type = enum_decl->isFixed()
-                                  ? enum_decl->getIntegerType().getAsString(_transition_unit_ctx->getLangOpts())
-                                  : "unfixed";
-  enum_data.attrs = help::parse_attr(enum_decl);
+  if (_has_key("Enum", "attrs"))
+    enum_data.attrs = _parse_attr(enum_decl);
+  if (_has_key("Enum", "attributes"))
+    enum_data.attributes = _parse_attributes(enum_decl);
+  if (_has_key("Enum", "structural_hash"))
+    enum_data.structural_hash = help::get_enum_structural_hash(enum_decl, _transition_unit_ctx, _filter);
+
+  // underlying type
+  auto integer_type = enum_decl->getIntegerType();
+  enum_data.is_fixed = enum_decl->isFixed();
+  if (!integer_type.isNull()) {
+    enum_data.underlying_type = integer_type.getAsString(_transition_unit_ctx->getLangOpts());
+    enum_data.is_signed = integer_type->isSignedIntegerOrEnumerationType();
+    enum_data.bit_width = _transition_unit_ctx->getIntWidth(integer_type);
+  }
 
   // parse enum item
   for (auto enumerator : enum_decl->enumerators()) {
     EnumValue enumerator_data;
     // parse comment & location
-    enumerator_data.comment = help::get_comment(enumerator, _transition_unit_ctx, source_manager);
+    if (_has_key("EnumValue", "comment"))
+      enumerator_data.comment = help::get_comment(enumerator, _transition_unit_ctx, source_manager);
     enumerator_data.line = source_manager.getPresumedLineNumber(enumerator->getLocation());
 
     // parse enum item data
     enumerator_data.name = enumerator->getQualifiedNameAsString();
-    enumerator_data.value = enumerator->getInitVal().getRawData()[0];
-    enumerator_data.attrs = help::parse_attr(enumerator);
+    auto init_value = enumerator->getInitVal().extOrTrunc(64);
+    enumerator_data.value = enum_data.is_signed ? init_value.getSExtValue() : int64_t(init_value.getZExtValue());
+    enumerator_data.is_signed = enum_data.is_signed;
+    if (_has_key("EnumValue", "attrs"))
+      enumerator_data.attrs = _parse_attr(enumerator);
+    if (_has_key("EnumValue", "attributes"))
+      enumerator_data.attributes = _parse_attributes(enumerator);
 
     // push enum item
     enum_data.values.push_back(std::move(enumerator_data));
   }
 
+  // value set shape
+  help::fill_enum_shape(enum_data);
+
+  // name lookup table
+  if (_has_key("Enum", "value_hash")) {
+    std::vector<std::string> names;
+    for (auto enumerator : enum_decl->enumerators()) {
+      names.push_back(enumerator->getNameAsString());
+    }
+    enum_data.value_hash = build_perfect_hash(names);
+  }
+
   // push enum
   _get_file_db(rel_file_name).enums.push_back(std::move(enum_data));
 }
@@ -453,6 +720,10 @@ void ASTConsumer::handle_function(clang::NamedDecl *decl) {
   if (decl->isInvalidDecl())
     return;
 
+  // filter namespace
+  if (!_filter_namespace(decl))
+    return;
+
   // filter location
   clang::SourceManager &source_manager = _transition_unit_ctx->getSourceManager();
   clang::PresumedLoc location = source_manager.getPresumedLoc(decl->getLocation());
@@ -487,19 +758,21 @@ void ASTConsumer::handle_function(clang::NamedDecl *decl) {
   Function func_data;
 
   // comment & location
-  func_data.comment = help::get_comment(func_decl, _transition_unit_ctx, source_manager);
+  if (_has_key("Function", "comment"))
+    func_data.comment = help::get_comment(func_decl, _transition_unit_ctx, source_manager);
   func_data.file_name = abs_file_name;
   func_data.line = line;
 
   // parse function data
-  _fill_function_data(func_decl, func_data);
+  auto &db = _get_file_db(rel_file_name);
+  _fill_function_data(func_decl, func_data, db);
 
   // unused function data
   func_data.access = help::get_access_string(func_decl->getAccess());
   func_data.is_const = false;
 
   // push function
-  _get_file_db(rel_file_name).functions.push_back(std::move(func_data));
+  db.functions.push_back(std::move(func_data));
 }
 void ASTConsumer::handle_template(clang::NamedDecl *decl) {
   // unsupported now
@@ -514,11 +787,15 @@ void ASTConsumer::handle_template(clang::NamedDecl *decl) {
 }
 
 // leaf level parse functions
-std::optional<Function> ASTConsumer::handle_method(clang::NamedDecl *decl) {
+std::optional<Function> ASTConsumer::handle_method(clang::NamedDecl *decl, Database &db) {
   // filter invalid decl
   if (decl->isInvalidDecl())
     return {};
 
+  // filter member opt-in
+  if (!_filter_member(decl))
+    return {};
+
   // filter location
   clang::SourceManager &source_manager = _transition_unit_ctx->getSourceManager();
   clang::PresumedLoc location = source_manager.getPresumedLoc(decl->getLocation());
@@ -548,12 +825,13 @@ std::optional<Function> ASTConsumer::handle_method(clang::NamedDecl *decl) {
   Function out_method = {};
 
   // comment & location
-  out_method.comment = help::get_comment(method_decl, _transition_unit_ctx, source_manager);
+  if (_has_key("Function", "comment"))
+    out_method.comment = help::get_comment(method_decl, _transition_unit_ctx, source_manager);
   out_method.file_name = abs_file_name;
   out_method.line = line;
 
   // parse method data
-  _fill_function_data(method_decl, out_method);
+  _fill_function_data(method_decl, out_method, db);
 
   // access & const
   out_method.access = help::get_access_string(method_decl->getAccess());
@@ -561,11 +839,15 @@ std::optional<Function> ASTConsumer::handle_method(clang::NamedDecl *decl) {
 
   return std::move(out_method);
 }
-std::optional<Function> ASTConsumer::handle_static_method(clang::NamedDecl *decl) {
+std::optional<Function> ASTConsumer::handle_static_method(clang::NamedDecl *decl, Database &db) {
   // filter invalid decl
   if (decl->isInvalidDecl())
     return {};
 
+  // filter member opt-in
+  if (!_filter_member(decl))
+    return {};
+
   // filter location
   clang::SourceManager &source_manager = _transition_unit_ctx->getSourceManager();
   clang::PresumedLoc location = source_manager.getPresumedLoc(decl->getLocation());
@@ -595,12 +877,13 @@ std::optional<Function> ASTConsumer::handle_static_method(clang::NamedDecl *decl
   Function out_method = {};
 
   // comment & location
-  out_method.comment = help::get_comment(func_decl, _transition_unit_ctx, source_manager);
+  if (_has_key("Function", "comment"))
+    out_method.comment = help::get_comment(func_decl, _transition_unit_ctx, source_manager);
   out_method.file_name = abs_file_name;
   out_method.line = line;
 
   // parse function data
-  _fill_function_data(func_decl, out_method);
+  _fill_function_data(func_decl, out_method, db);
 
   // access & const
   out_method.access = help::get_access_string(func_decl->getAccess());
@@ -608,11 +891,15 @@ std::optional<Function> ASTConsumer::handle_static_method(clang::NamedDecl *decl
 
   return std::move(out_method);
 }
-std::optional<Field> ASTConsumer::handle_field(clang::NamedDecl *decl) {
+std::optional<Field> ASTConsumer::handle_field(clang::NamedDecl *decl, Database &db) {
   // filter invalid decl
   if (decl->isInvalidDecl())
     return {};
 
+  // filter member opt-in
+  if (!_filter_member(decl))
+    return {};
+
   // filter location
   clang::SourceManager &source_manager = _transition_unit_ctx->getSourceManager();
   clang::PresumedLoc location = source_manager.getPresumedLoc(decl->getLocation());
@@ -642,45 +929,43 @@ std::optional<Field> ASTConsumer::handle_field(clang::NamedDecl *decl) {
   Field out_field = {};
 
   // comment & location
-  out_field.comment = help::get_comment(field_decl, _transition_unit_ctx, source_manager);
+  if (_has_key("Field", "comment"))
+    out_field.comment = help::get_comment(field_decl, _transition_unit_ctx, source_manager);
   out_field.line = line;
 
   // parse field data
   out_field.name = field_decl->getNameAsString();
-  out_field.attrs = help::parse_attr(field_decl);
+  if (_has_key("Field", "attrs"))
+    out_field.attrs = _parse_attr(field_decl);
+  if (_has_key("Field", "attributes"))
+    out_field.attributes = _parse_attributes(field_decl);
   out_field.access = help::get_access_string(field_decl->getAccess());
   out_field.is_static = false;
 
-  // parse array data
-  if (field_decl->getType()->isConstantArrayType()) {
-    auto ftype =
-        llvm::dyn_cast<clang::ConstantArrayType>(field_decl->getType());
-    out_field.array_size = ftype->getSize().getZExtValue();
-    out_field.type = help::get_type_name(ftype->getElementType(), _transition_unit_ctx);
-    out_field.raw_type = help::get_raw_type_name(ftype->getElementType(), _transition_unit_ctx);
-  } else {
-    out_field.array_size = 0;
-    out_field.type = help::get_type_name(field_decl->getType(), _transition_unit_ctx);
-    out_field.raw_type = help::get_raw_type_name(field_decl->getType(), _transition_unit_ctx);
-  }
+  // parse type & array data
+  _fill_field_type(field_decl->getType(), out_field);
 
   // default value
-  if (field_decl->hasInClassInitializer()) {
+  if (field_decl->hasInClassInitializer() && _has_key("Field", "default_value")) {
     llvm::raw_string_ostream s(out_field.default_value);
     auto defArg = field_decl->getInClassInitializer();
     defArg->printPretty(s, nullptr, _transition_unit_ctx->getPrintingPolicy());
   }
 
   // handle if field is function pointer
-  _fill_function_pointer(field_decl, out_field);
+  _fill_function_pointer(field_decl, out_field, db);
 
   return out_field;
 }
-std::optional<Field> ASTConsumer::handle_static_field(clang::NamedDecl *decl) {
+std::optional<Field> ASTConsumer::handle_static_field(clang::NamedDecl *decl, Database &db) {
   // filter invalid decl
   if (decl->isInvalidDecl())
     return {};
 
+  // filter member opt-in
+  if (!_filter_member(decl))
+    return {};
+
   // filter location
   clang::SourceManager &source_manager = _transition_unit_ctx->getSourceManager();
   clang::PresumedLoc location = source_manager.getPresumedLoc(decl->getLocation());
@@ -710,38 +995,36 @@ std::optional<Field> ASTConsumer::handle_static_field(clang::NamedDecl *decl) {
   Field out_field = {};
 
   // comment & location
-  out_field.comment = help::get_comment(var_decl, _transition_unit_ctx, source_manager);
+  if (_has_key("Field", "comment"))
+    out_field.comment = help::get_comment(var_decl, _transition_unit_ctx, source_manager);
   out_field.line = line;
 
   // field data
   out_field.name = var_decl->getNameAsString();
-  out_field.attrs = help::parse_attr(var_decl);
+  if (_has_key("Field", "attrs"))
+    out_field.attrs = _parse_attr(var_decl);
+  if (_has_key("Field", "attributes"))
+    out_field.attributes = _parse_attributes(var_decl);
   out_field.access = help::get_access_string(var_decl->getAccess());
   out_field.is_static = true;
 
-  // parse array data
-  if (var_decl->getType()->isConstantArrayType()) {
-    auto ftype =
-        llvm::dyn_cast<clang::ConstantArrayType>(var_decl->getType());
-    out_field.array_size = ftype->getSize().getZExtValue();
-    out_field.type = help::get_type_name(ftype->getElementType(), _transition_unit_ctx);
-    out_field.raw_type = help::get_raw_type_name(ftype->getElementType(), _transition_unit_ctx);
-  } else {
-    out_field.array_size = 0;
-    out_field.type = help::get_type_name(var_decl->getType(), _transition_unit_ctx);
-    out_field.raw_type = help::get_raw_type_name(var_decl->getType(), _transition_unit_ctx);
-  }
+  // parse type & array data
+  _fill_field_type(var_decl->getType(), out_field);
 
   // handle if field is function pointer
-  _fill_function_pointer(var_decl, out_field);
+  _fill_function_pointer(var_decl, out_field, db);
 
   return std::move(out_field);
 }
-std::optional<Constructor> ASTConsumer::handle_constructor(clang::NamedDecl *decl) {
+std::optional<Constructor> ASTConsumer::handle_constructor(clang::NamedDecl *decl, Database &db) {
   // filter invalid decl
   if (decl->isInvalidDecl())
     return {};
 
+  // filter member opt-in
+  if (!_filter_member(decl))
+    return {};
+
   // filter location
   clang::SourceManager &source_manager = _transition_unit_ctx->getSourceManager();
   clang::PresumedLoc location = source_manager.getPresumedLoc(decl->getLocation());
@@ -771,13 +1054,14 @@ std::optional<Constructor> ASTConsumer::handle_constructor(clang::NamedDecl *dec
   Constructor out_ctor = {};
 
   // comment & location
-  out_ctor.comment = help::get_comment(ctor_decl, _transition_unit_ctx, source_manager);
+  if (_has_key("Constructor", "comment"))
+    out_ctor.comment = help::get_comment(ctor_decl, _transition_unit_ctx, source_manager);
   out_ctor.file_name = abs_file_name;
   out_ctor.line = line;
 
   // llvm::outs() << "ctor: " << ctor_decl->getQualifiedNameAsString() << "\n";
   // parse method data
-  _fill_ctor_data(ctor_decl, out_ctor);
+  _fill_ctor_data(ctor_decl, out_ctor, db);
   // llvm::outs() << "end ctor: " << ctor_decl->getQualifiedNameAsString() << "\n";
 
   // access & const
@@ -802,6 +1086,18 @@ bool ASTConsumer::_filter_decl_location(clang::NamedDecl *decl,
 
   // location info
   out_abs_file_name = help::get_decl_file_name(decl, location);
+
+  // decls deserialized from a module file may carry a path relative to where the module was built,
+  // the file entry knows where the header really is
+  auto &source_manager = _transition_unit_ctx->getSourceManager();
+  auto decl_loc = source_manager.getExpansionLoc(decl->getLocation());
+  if (source_manager.isLoadedSourceLocation(decl_loc) && !llvm::sys::path::is_absolute(location.getFilename())) {
+    if (auto file = source_manager.getFileEntryRefForID(source_manager.getFileID(decl_loc))) {
+      auto real_path = source_manager.getFileManager().getCanonicalName(*file);
+      if (!real_path.empty())
+        out_abs_file_name = llvm::sys::path::convert_to_slash(real_path);
+    }
+  }
   out_rel_file_name = help::relative_path(_root, out_abs_file_name);
   out_line = location.getLine();
 
@@ -815,14 +1111,19 @@ bool ASTConsumer::_filter_decl_location(clang::NamedDecl *decl,
   return true;
 }
 bool ASTConsumer::_filter_parsed_identity(clang::NamedDecl *decl, const std::string &file_name, unsigned line) {
-  Identity ident;
-  ident.fileName = file_name;
-  ident.line = line;
-  bool is_parsed = _parsed.find(ident) != _parsed.end();
+  // forward declaration shares usr with its definition, don't let it hide the definition
+  if (auto tag_decl = llvm::dyn_cast<clang::TagDecl>(decl)) {
+    if (!tag_decl->isThisDeclarationADefinition())
+      return true;
+  }
+
+  // usr is unique across translation units, fallback to location for decl without usr
+  auto usr = help::get_usr(decl);
+  uint64_t id = usr.empty() ? help::get_id(file_name + ":" + std::to_string(line)) : help::get_id(usr);
+  bool is_parsed = !_parsed.insert(id).second;
   if (is_parsed && decl->getKind() != clang::Decl::Namespace) {
     return false;
   }
-  _parsed.insert(ident);
   return true;
 }
 bool ASTConsumer::_filter_reflect_flag(clang::NamedDecl *decl) {
@@ -844,51 +1145,107 @@ bool ASTConsumer::_filter_reflect_flag(clang::NamedDecl *decl) {
   }
   return true;
 }
+bool ASTConsumer::_filter_namespace(clang::NamedDecl *decl) {
+  return !_filter || _filter->accept_namespace_of(decl);
+}
+bool ASTConsumer::_filter_member(clang::NamedDecl *decl) {
+  return !_filter || _filter->accept_member(decl);
+}
+std::vector<std::string> ASTConsumer::_parse_attr(clang::NamedDecl *decl) {
+  return help::parse_attr(decl, _filter);
+}
+llvm::json::Object ASTConsumer::_parse_attributes(clang::NamedDecl *decl) {
+  auto prefix = _attr_prefix();
+  auto &diags = _transition_unit_ctx->getDiagnostics();
+  llvm::json::Object attributes;
+  for (auto annotate : decl->specific_attrs<clang::AnnotateAttr>()) {
+    auto text = annotate->getAnnotation();
+    if (!help::is_attr_exported(_filter, text))
+      continue;
+    text = text.drop_front(prefix.size());
+    auto report = [&](llvm::StringRef message) {
+      auto diag_id = diags.getCustomDiagID(clang::DiagnosticsEngine::Error, "malformed annotation '%0': %1");
+      diags.Report(annotate->getLocation(), diag_id) << annotate->getAnnotation() << message;
+    };
+
+    // annotate("key", args...), one argument is the value, more become an array
+    if (annotate->args_size() != 0) {
+      if (text.trim().empty()) {
+        report("arguments need a key");
+        continue;
+      }
+      llvm::json::Array args;
+      for (auto arg : annotate->args())
+        args.push_back(help::annotate_arg_value(arg, _transition_unit_ctx));
+      // owned keys, attributes outlive the annotation text in the AST
+      if (args.size() == 1)
+        attributes[text.trim().str()] = std::move(args.front());
+      else
+        attributes[text.trim().str()] = std::move(args);
+      continue;
+    }
+
+    // annotate("text"), later keys overwrite earlier ones
+    auto parsed = parse_annotation(text);
+    if (!parsed) {
+      report(llvm::toString(parsed.takeError()));
+      continue;
+    }
+    for (auto &[key, value] : *parsed)
+      attributes[key.str().str()] = std::move(value);
+  }
+  return attributes;
+}
 Database &ASTConsumer::_get_file_db(const std::string &rel_file_name) {
   return _datamap[rel_file_name];
 }
-void ASTConsumer::_fill_function_data(clang::FunctionDecl *func_decl, Function &out_func_data) {
+void ASTConsumer::_fill_function_data(clang::FunctionDecl *func_decl, Function &out_func_data, Database &db) {
   // parse function data
   out_func_data.name = func_decl->getQualifiedNameAsString();
+  out_func_data.usr = help::get_usr(func_decl);
+  out_func_data.id = help::get_id(out_func_data.usr);
   out_func_data.is_static = func_decl->isStatic();
   auto func_proto_type = func_decl->getType()->getAs<clang::FunctionProtoType>();
   out_func_data.is_nothrow = func_proto_type ? func_proto_type->isNothrow() : false;
-  out_func_data.attrs = help::parse_attr(func_decl);
+  if (_has_key("Function", "attrs"))
+    out_func_data.attrs = _parse_attr(func_decl);
+  if (_has_key("Function", "attributes"))
+    out_func_data.attributes = _parse_attributes(func_decl);
   if (!func_decl->isNoReturn()) {
-    out_func_data.ret_type = help::get_type_name(func_decl->getReturnType(), _transition_unit_ctx);
-    out_func_data.raw_ret_type = help::get_raw_type_name(func_decl->getReturnType(), _transition_unit_ctx);
+    if (_has_key("Function", "ret_type"))
+      out_func_data.ret_type = help::get_type_name(func_decl->getReturnType(), _transition_unit_ctx);
+    if (_has_key("Function", "raw_ret_type"))
+      out_func_data.raw_ret_type = help::get_raw_type_name(func_decl->getReturnType(), _transition_unit_ctx);
   }
 
   // parse parameters
+  if (!_has_key("Function", "parameters"))
+    return;
+  std::vector<Field> parameters;
   for (auto param : func_decl->parameters()) {
     Field param_data;
 
     // comment & location
-    param_data.comment = help::get_comment(param, _transition_unit_ctx, _transition_unit_ctx->getSourceManager());
+    if (_has_key("Field", "comment"))
+      param_data.comment = help::get_comment(param, _transition_unit_ctx, _transition_unit_ctx->getSourceManager());
     param_data.line = _transition_unit_ctx->getSourceManager().getPresumedLineNumber(param->getLocation());
 
     // parse parameter data
     param_data.name = param->getNameAsString();
     if (param_data.name.empty()) {
-      param_data.name = "unnamed" + std::to_string(out_func_data.parameters.size());
+      param_data.name = "unnamed" + std::to_string(parameters.size());
       param_data.is_anonymous = true;
     }
-    param_data.attrs = help::parse_attr(param);
-
-    // parse array data
-    if (param->getType()->isConstantArrayType()) {
-      auto ftype = llvm::dyn_cast<clang::ConstantArrayType>(param->getType());
-      param_data.array_size = ftype->getSize().getZExtValue();
-      param_data.type = help::get_type_name(ftype->getElementType(), _transition_unit_ctx);
-      param_data.raw_type = help::get_raw_type_name(ftype->getElementType(), _transition_unit_ctx);
-    } else {
-      param_data.array_size = 0;
-      param_data.type = help::get_type_name(param->getType(), _transition_unit_ctx);
-      param_data.raw_type = help::get_raw_type_name(param->getType(), _transition_unit_ctx);
-    }
+    if (_has_key("Field", "attrs"))
+      param_data.attrs = _parse_attr(param);
+    if (_has_key("Field", "attributes"))
+      param_data.attributes = _parse_attributes(param);
+
+    // parse type & array data
+    _fill_field_type(param->getType(), param_data);
 
     // parse default value
-    if (param->hasDefaultArg()) {
+    if (param->hasDefaultArg() && _has_key("Field", "default_value")) {
       llvm::raw_string_ostream s(param_data.default_value);
       if (param->hasUninstantiatedDefaultArg()) {
         auto defArg = param->getUninstantiatedDefaultArg();
@@ -903,13 +1260,33 @@ void ASTConsumer::_fill_function_data(clang::FunctionDecl *func_decl, Function &
     param_data.access = help::get_access_string(clang::AS_none);
 
     // handle if function pointer
-    _fill_function_pointer(param, param_data);
+    _fill_function_pointer(param, param_data, db);
 
     // push parameter
-    out_func_data.parameters.push_back(std::move(param_data));
+    parameters.push_back(std::move(param_data));
   }
+  out_func_data.parameters = Database::add_rows(db.params, std::move(parameters));
 }
-void ASTConsumer::_fill_function_pointer(clang::DeclaratorDecl *decl, Field &out_field) {
+void ASTConsumer::_fill_field_type(clang::QualType type, Field &out_field) {
+  // parse array data
+  out_field.array_size = 0;
+  if (type->isConstantArrayType()) {
+    auto array_type = llvm::dyn_cast<clang::ConstantArrayType>(type);
+    out_field.array_size = array_type->getSize().getZExtValue();
+    type = array_type->getElementType();
+  }
+
+  // parse type data
+  if (_has_key("Field", "type"))
+    out_field.type = help::get_type_name(type, _transition_unit_ctx);
+  if (_has_key("Field", "raw_type"))
+    out_field.raw_type = help::get_raw_type_name(type, _transition_unit_ctx);
+  if (_has_key("Field", "type_id"))
+    out_field.type_id = help::get_type_id(type, _transition_unit_ctx);
+  if (_has_key("Field", "type_hash"))
+    out_field.type_hash = help::get_type_hash(type, _transition_unit_ctx);
+}
+void ASTConsumer::_fill_function_pointer(clang::DeclaratorDecl *decl, Field &out_field, Database &db) {
   // init
   clang::Decl *signature_decl = decl;
   clang::QualType signature_type = decl->getType();
@@ -971,6 +1348,7 @@ void ASTConsumer::_fill_function_pointer(clang::DeclaratorDecl *decl, Field &out
   // visit parameters
   ParmVisitor param_visitor;
   param_visitor.consumer = this;
+  param_visitor.db = &db;
   param_visitor.root_decl = signature_decl;
   param_visitor.TraverseDecl(signature_decl);
 
@@ -979,62 +1357,72 @@ void ASTConsumer::_fill_function_pointer(clang::DeclaratorDecl *decl, Field &out
   out_field.is_callback = true;
 
   // signature comment & location
-  out_field.signature.comment = help::get_comment(signature_decl, transition_unit_ctx(), transition_unit_ctx()->getSourceManager());
-  out_field.signature.file_name = help::get_decl_file_name(signature_decl, transition_unit_ctx()->getSourceManager().getPresumedLoc(signature_decl->getLocation()));
-  out_field.signature.line = transition_unit_ctx()->getSourceManager().getPresumedLineNumber(signature_decl->getLocation());
+  Function signature;
+  if (_has_key("Function", "comment"))
+    signature.comment = help::get_comment(signature_decl, transition_unit_ctx(), transition_unit_ctx()->getSourceManager());
+  signature.file_name = help::get_decl_file_name(signature_decl, transition_unit_ctx()->getSourceManager().getPresumedLoc(signature_decl->getLocation()));
+  signature.line = transition_unit_ctx()->getSourceManager().getPresumedLineNumber(signature_decl->getLocation());
 
   // fill signature data
-  out_field.signature.name = out_field.name;
-  out_field.signature.attrs = out_field.attrs;
+  signature.name = out_field.name;
+  signature.attrs = out_field.attrs;
+  signature.attributes = out_field.attributes;
   auto func_proto_type = final_func_type->getAs<clang::FunctionProtoType>();
-  out_field.signature.is_nothrow = func_proto_type ? func_proto_type->isNothrow() : false;
-  out_field.signature.ret_type = help::get_type_name(final_func_type->getReturnType(), transition_unit_ctx());
-  out_field.signature.raw_ret_type = help::get_raw_type_name(final_func_type->getReturnType(), transition_unit_ctx());
+  signature.is_nothrow = func_proto_type ? func_proto_type->isNothrow() : false;
+  if (_has_key("Function", "ret_type"))
+    signature.ret_type = help::get_type_name(final_func_type->getReturnType(), transition_unit_ctx());
+  if (_has_key("Function", "raw_ret_type"))
+    signature.raw_ret_type = help::get_raw_type_name(final_func_type->getReturnType(), transition_unit_ctx());
 
   // fill parameters
-  out_field.signature.parameters = std::move(param_visitor.parameters);
+  signature.parameters = Database::add_rows(db.params, std::move(param_visitor.parameters));
 
   // signature unused data
-  out_field.signature.access = help::get_access_string(clang::AS_none);
-  out_field.signature.is_static = true;
-  out_field.signature.is_const = false;
+  signature.access = help::get_access_string(clang::AS_none);
+  signature.is_static = true;
+  signature.is_const = false;
+
+  // push signature
+  out_field.signature = db.signatures.size();
+  db.signatures.push_back(std::move(signature));
 }
-void ASTConsumer::_fill_ctor_data(clang::CXXConstructorDecl *ctor_decl, Constructor &out_ctor_data) {
+void ASTConsumer::_fill_ctor_data(clang::CXXConstructorDecl *ctor_decl, Constructor &out_ctor_data, Database &db) {
   // parse function data
   out_ctor_data.name = ctor_decl->getQualifiedNameAsString();
   auto func_proto_type = ctor_decl->getType()->getAs<clang::FunctionProtoType>();
-  out_ctor_data.attrs = help::parse_attr(ctor_decl);
+  if (_has_key("Constructor", "attrs"))
+    out_ctor_data.attrs = _parse_attr(ctor_decl);
+  if (_has_key("Constructor", "attributes"))
+    out_ctor_data.attributes = _parse_attributes(ctor_decl);
   
   // parse parameters
+  if (!_has_key("Constructor", "parameters"))
+    return;
+  std::vector<Field> parameters;
   for (auto param : ctor_decl->parameters()) {
     Field param_data;
 
     // comment & location
-    param_data.comment = help::get_comment(param, _transition_unit_ctx, _transition_unit_ctx->getSourceManager());
+    if (_has_key("Field", "comment"))
+      param_data.comment = help::get_comment(param, _transition_unit_ctx, _transition_unit_ctx->getSourceManager());
     param_data.line = _transition_unit_ctx->getSourceManager().getPresumedLineNumber(param->getLocation());
 
     // parse parameter data
     param_data.name = param->getNameAsString();
     if (param_data.name.empty()) {
-      param_data.name = "unnamed" + std::to_string(out_ctor_data.parameters.size());
+      param_data.name = "unnamed" + std::to_string(parameters.size());
       param_data.is_anonymous = true;
     }
-    param_data.attrs = help::parse_attr(param);
-
-    // parse array data
-    if (param->getType()->isConstantArrayType()) {
-      auto ftype = llvm::dyn_cast<clang::ConstantArrayType>(param->getType());
-      param_data.array_size = ftype->getSize().getZExtValue();
-      param_data.type = help::get_type_name(ftype->getElementType(), _transition_unit_ctx);
-      param_data.raw_type = help::get_raw_type_name(ftype->getElementType(), _transition_unit_ctx);
-    } else {
-      param_data.array_size = 0;
-      param_data.type = help::get_type_name(param->getType(), _transition_unit_ctx);
-      param_data.raw_type = help::get_raw_type_name(param->getType(), _transition_unit_ctx);
-    }
+    if (_has_key("Field", "attrs"))
+      param_data.attrs = _parse_attr(param);
+    if (_has_key("Field", "attributes"))
+      param_data.attributes = _parse_attributes(param);
+
+    // parse type & array data
+    _fill_field_type(param->getType(), param_data);
 
     // parse default value
-    if (param->hasDefaultArg()) {
+    if (param->hasDefaultArg() && _has_key("Field", "default_value")) {
       llvm::raw_string_ostream s(param_data.default_value);
       if (param->hasUninstantiatedDefaultArg()) {
         auto defArg = param->getUninstantiatedDefaultArg();
@@ -1049,10 +1437,11 @@ void ASTConsumer::_fill_ctor_data(clang::CXXConstructorDecl *ctor_decl, Construc
     param_data.access = help::get_access_string(clang::AS_none);
 
     // handle if function pointer
-    _fill_function_pointer(param, param_data);
+    _fill_function_pointer(param, param_data, db);
 
     // push parameter
-    out_ctor_data.parameters.push_back(std::move(param_data));
+    parameters.push_back(std::move(param_data));
   }
+  out_ctor_data.parameters = Database::add_rows(db.params, std::move(parameters));
 }
 } // namespace meta
\ No newline at end of file
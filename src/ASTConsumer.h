@@ -1,5 +1,8 @@
 #pragma once
 
+#include "LayoutReport.h"
+#include "OutputSchema.h"
+#include "ReflectFilter.h"
 #include "meta.h"
 #include "clang/AST/ASTConsumer.h"
 #include "clang/AST/Decl.h"
@@ -13,7 +16,8 @@ using namespace clang;
 
 class ASTConsumer : public clang::ASTConsumer {
 public:
-  ASTConsumer(FileDataMap &datamap, std::string root);
+  ASTConsumer(FileDataMap &datamap, std::string root, LayoutReport *layout_report = nullptr,
+              const ReflectFilter *filter = nullptr, const OutputSchema *schema = nullptr);
 
   // getter
   ASTContext *transition_unit_ctx() { return _transition_unit_ctx; }
@@ -28,12 +32,12 @@ public:
   void handle_function(clang::NamedDecl *decl);
   void handle_template(clang::NamedDecl *decl);
 
-  // leaf level parse functions
-  std::optional<Function> handle_method(clang::NamedDecl *decl);
-  std::optional<Function> handle_static_method(clang::NamedDecl *decl);
-  std::optional<Field> handle_field(clang::NamedDecl *decl);
-  std::optional<Field> handle_static_field(clang::NamedDecl *decl);
-  std::optional<Constructor> handle_constructor(clang::NamedDecl *decl);
+  // leaf level parse functions, parameters and signatures are added to tables of db
+  std::optional<Function> handle_method(clang::NamedDecl *decl, Database &db);
+  std::optional<Function> handle_static_method(clang::NamedDecl *decl, Database &db);
+  std::optional<Field> handle_field(clang::NamedDecl *decl, Database &db);
+  std::optional<Field> handle_static_field(clang::NamedDecl *decl, Database &db);
+  std::optional<Constructor> handle_constructor(clang::NamedDecl *decl, Database &db);
 
 protected:
   friend class ::ParmVisitor;
@@ -46,18 +50,30 @@ protected:
                              unsigned &out_line);
   bool _filter_parsed_identity(clang::NamedDecl *decl, const std::string &file_name, unsigned line);
   bool _filter_reflect_flag(clang::NamedDecl *decl);
+  bool _filter_namespace(clang::NamedDecl *decl);
+  bool _filter_member(clang::NamedDecl *decl);
+  llvm::StringRef _attr_prefix() const { return _filter ? _filter->attr_prefix() : llvm::StringRef(); }
+  std::vector<std::string> _parse_attr(clang::NamedDecl *decl);
+  // malformed annotations are reported as errors at their location
+  llvm::json::Object _parse_attributes(clang::NamedDecl *decl);
+  // data of keys dropped by output schema is not computed
+  bool _has_key(std::string_view type, std::string_view key) const { return !_schema || _schema->has(type, key); }
   Database &_get_file_db(const std::string &rel_file_name);
-  void _fill_function_data(clang::FunctionDecl *func_decl, Function &out_func_data);
-  void _fill_function_pointer(clang::DeclaratorDecl *decl, Field &out_field);
-  void _fill_ctor_data(clang::CXXConstructorDecl *ctor_decl, Constructor &out_ctor_data);
+  void _fill_function_data(clang::FunctionDecl *func_decl, Function &out_func_data, Database &db);
+  void _fill_field_type(clang::QualType type, Field &out_field);
+  void _fill_function_pointer(clang::DeclaratorDecl *decl, Field &out_field, Database &db);
+  void _fill_ctor_data(clang::CXXConstructorDecl *ctor_decl, Constructor &out_ctor_data, Database &db);
 
 protected:
   // config
   FileDataMap &_datamap;
   std::string _root = {};
+  LayoutReport *_layout_report = nullptr;
+  const ReflectFilter *_filter = nullptr;
+  const OutputSchema *_schema = nullptr;
 
   // 跳过前置声明的重复解析
-  std::unordered_set<meta::Identity, meta::IdentityHash> _parsed = {};
+  std::unordered_set<uint64_t> _parsed = {};
 
   // 编译单元的节点
   ASTContext *_transition_unit_ctx = nullptr;
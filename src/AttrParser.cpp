@@ -0,0 +1,118 @@
+#include "AttrParser.h"
+#include "llvm/ADT/SmallVector.h"
+
+namespace {
+llvm::Error make_error(const llvm::Twine &message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(), message);
+}
+
+// split at commas outside of quotes and brackets
+llvm::Error split_items(llvm::StringRef text, llvm::SmallVectorImpl<llvm::StringRef> &out_items) {
+  llvm::SmallVector<char, 8> brackets;
+  bool in_string = false;
+  size_t item_begin = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    char c = text[i];
+    if (in_string) {
+      if (c == '\\')
+        ++i;
+      else if (c == '"')
+        in_string = false;
+      continue;
+    }
+    switch (c) {
+    case '"':
+      in_string = true;
+      break;
+    case '[':
+      brackets.push_back(']');
+      break;
+    case '{':
+      brackets.push_back('}');
+      break;
+    case ']':
+    case '}':
+      if (brackets.empty() || brackets.back() != c)
+        return make_error(llvm::Twine("unbalanced '") + llvm::Twine(c) + "' at column " + llvm::Twine(i + 1));
+      brackets.pop_back();
+      break;
+    case ',':
+      if (brackets.empty()) {
+        out_items.push_back(text.slice(item_begin, i));
+        item_begin = i + 1;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+  if (in_string)
+    return make_error("unterminated string");
+  if (!brackets.empty())
+    return make_error(llvm::Twine("missing '") + llvm::Twine(brackets.back()) + "'");
+  out_items.push_back(text.substr(item_begin));
+  return llvm::Error::success();
+}
+
+llvm::Expected<llvm::json::Value> parse_value(llvm::StringRef key, llvm::StringRef text) {
+  // quoted, array and object values must be valid json
+  if (text.front() == '"' || text.front() == '[' || text.front() == '{') {
+    auto value = llvm::json::parse(text);
+    if (!value)
+      return make_error("invalid value of '" + key + "': " + llvm::toString(value.takeError()));
+    return std::move(*value);
+  }
+
+  // number, bool and null literal, otherwise plain text
+  auto value = llvm::json::parse(text);
+  if (value && value->kind() != llvm::json::Value::String)
+    return std::move(*value);
+  if (!value)
+    llvm::consumeError(value.takeError());
+  return llvm::json::Value(text.str());
+}
+} // namespace
+
+namespace meta {
+llvm::Expected<llvm::json::Object> parse_annotation(llvm::StringRef text) {
+  text = text.trim();
+  if (text.empty())
+    return llvm::json::Object();
+
+  // json object
+  if (text.starts_with("{")) {
+    auto value = llvm::json::parse(text);
+    if (!value)
+      return make_error(llvm::toString(value.takeError()));
+    auto object = value->getAsObject();
+    if (!object)
+      return make_error("annotation must be a json object");
+    return std::move(*object);
+  }
+
+  // key=value list
+  llvm::SmallVector<llvm::StringRef, 8> items;
+  if (auto err = split_items(text, items))
+    return std::move(err);
+  // keys are owned, the text belongs to the AST of the translation unit
+  llvm::json::Object result;
+  for (auto item : items) {
+    auto [key, value] = item.split('=');
+    key = key.trim();
+    value = value.trim();
+    if (key.empty())
+      return make_error("empty key in '" + item.trim() + "'");
+    if (item.find('=') == llvm::StringRef::npos) {
+      result[key.str()] = true;
+      continue;
+    }
+    if (value.empty())
+      return make_error("missing value of '" + key + "'");
+    auto parsed = parse_value(key, value);
+    if (!parsed)
+      return parsed.takeError();
+    result[key.str()] = std::move(*parsed);
+  }
+  return result;
+}
+} // namespace meta
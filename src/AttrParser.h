@@ -0,0 +1,13 @@
+#pragma once
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+
+namespace meta {
+// annotation text syntax, parsed into one json object:
+//   {"key": value, ...}   json object
+//   key, key=value, ...   bare key is true, value is a json literal (number, true, false, null, "string",
+//                         [...], {...}) or plain text up to the next top level comma, spaces around are trimmed
+// e.g. `category=ai, range=[0, 100], hidden` -> {"category": "ai", "range": [0, 100], "hidden": true}
+llvm::Expected<llvm::json::Object> parse_annotation(llvm::StringRef text);
+} // namespace meta
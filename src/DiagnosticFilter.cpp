@@ -0,0 +1,53 @@
+#include "DiagnosticFilter.h"
+#include "IncludeGraph.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace meta {
+RootDiagnosticConsumer::RootDiagnosticConsumer(std::string root)
+    : _root(std::move(root)),
+      _printer(std::make_unique<clang::TextDiagnosticPrinter>(llvm::errs(), new clang::DiagnosticOptions())) {
+}
+
+void RootDiagnosticConsumer::BeginSourceFile(const clang::LangOptions &lang_opts, const clang::Preprocessor *pp) {
+  _printer->BeginSourceFile(lang_opts, pp);
+}
+void RootDiagnosticConsumer::EndSourceFile() {
+  _printer->EndSourceFile();
+}
+void RootDiagnosticConsumer::finish() {
+  _printer->finish();
+}
+void RootDiagnosticConsumer::clear() {
+  _printer->clear();
+  clang::DiagnosticConsumer::clear();
+}
+
+void RootDiagnosticConsumer::HandleDiagnostic(clang::DiagnosticsEngine::Level level, const clang::Diagnostic &info) {
+  // notes belong to the last diagnostic
+  if (level == clang::DiagnosticsEngine::Note) {
+    if (_suppress_notes)
+      return;
+  } else {
+    _suppress_notes = !_is_under_root(info);
+    if (_suppress_notes) {
+      ++_suppressed_count;
+      return;
+    }
+  }
+
+  clang::DiagnosticConsumer::HandleDiagnostic(level, info);
+  _printer->HandleDiagnostic(level, info);
+}
+
+bool RootDiagnosticConsumer::_is_under_root(const clang::Diagnostic &info) const {
+  // diagnostics without location (command line, fatal errors) are always shown
+  if (!info.getLocation().isValid() || !info.hasSourceManager())
+    return true;
+  clang::PresumedLoc location = info.getSourceManager().getPresumedLoc(info.getLocation());
+  if (location.isInvalid())
+    return true;
+  return llvm::StringRef(normalize_path(location.getFilename())).starts_with(_root);
+}
+} // namespace meta
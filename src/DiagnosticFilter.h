@@ -0,0 +1,31 @@
+#pragma once
+
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include <memory>
+#include <string>
+
+namespace meta {
+// prints only diagnostics located under root, notes follow their parent diagnostic
+class RootDiagnosticConsumer : public clang::DiagnosticConsumer {
+public:
+  explicit RootDiagnosticConsumer(std::string root);
+
+  void BeginSourceFile(const clang::LangOptions &lang_opts, const clang::Preprocessor *pp) override;
+  void EndSourceFile() override;
+  void finish() override;
+  void clear() override;
+  void HandleDiagnostic(clang::DiagnosticsEngine::Level level, const clang::Diagnostic &info) override;
+
+  // diagnostics hidden in current run
+  unsigned suppressed_count() const { return _suppressed_count; }
+
+private:
+  bool _is_under_root(const clang::Diagnostic &info) const;
+
+  std::string _root;
+  std::unique_ptr<clang::TextDiagnosticPrinter> _printer;
+  bool _suppress_notes = false;
+  unsigned _suppressed_count = 0;
+};
+} // namespace meta
@@ -0,0 +1,248 @@
+#include "FileSystemCache.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+// file served from FileSystemCache, the buffer is shared and never copied
+class CachedFile : public llvm::vfs::File {
+public:
+  CachedFile(llvm::vfs::Status status, const llvm::MemoryBuffer *content)
+      : _status(std::move(status)), _content(content) {}
+
+  llvm::ErrorOr<llvm::vfs::Status> status() override { return _status; }
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> getBuffer(const llvm::Twine &name, int64_t file_size,
+                                                               bool requires_null_terminator,
+                                                               bool is_volatile) override {
+    return llvm::MemoryBuffer::getMemBuffer(_content->getBuffer(), name.str(), requires_null_terminator);
+  }
+  std::error_code close() override { return {}; }
+
+private:
+  llvm::vfs::Status _status;
+  const llvm::MemoryBuffer *_content;
+};
+
+int64_t to_mtime(const llvm::sys::fs::file_status &status) {
+  return status.getLastModificationTime().time_since_epoch().count();
+}
+} // namespace
+
+namespace meta {
+FileSystemCache::FileSystemCache(std::vector<std::string> content_dirs)
+    : _content_dirs(std::move(content_dirs)) {
+}
+
+std::optional<llvm::ErrorOr<llvm::vfs::Status>> FileSystemCache::find_status(llvm::StringRef path) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto found = _entries.find(path);
+  if (found == _entries.end()) {
+    ++_miss_count;
+    return std::nullopt;
+  }
+  ++_hit_count;
+  if (!found->second.status)
+    return llvm::ErrorOr<llvm::vfs::Status>(llvm::errc::no_such_file_or_directory);
+  return llvm::ErrorOr<llvm::vfs::Status>(*found->second.status);
+}
+void FileSystemCache::store_status(llvm::StringRef path, const llvm::ErrorOr<llvm::vfs::Status> &status) {
+  // other errors (permission, io) may be temporary, don't cache them
+  if (!status && status.getError() != llvm::errc::no_such_file_or_directory)
+    return;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto &entry = _entries[path];
+  if (status) {
+    entry.status = *status;
+  } else {
+    entry.status.reset();
+    _record_dir_state(llvm::sys::path::parent_path(path, llvm::sys::path::Style::posix));
+  }
+}
+
+bool FileSystemCache::should_cache_content(llvm::StringRef path) const {
+  for (auto &dir : _content_dirs) {
+    if (path.starts_with(dir))
+      return true;
+  }
+  return false;
+}
+const llvm::MemoryBuffer *FileSystemCache::find_content(llvm::StringRef path) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto found = _entries.find(path);
+  if (found == _entries.end() || !found->second.status)
+    return nullptr;
+  return found->second.content.get();
+}
+const llvm::MemoryBuffer *FileSystemCache::store_content(llvm::StringRef path, std::unique_ptr<llvm::MemoryBuffer> content) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto &entry = _entries[path];
+  // another thread may load it at the same time, keep the first one
+  if (!entry.content)
+    entry.content = std::move(content);
+  return entry.content.get();
+}
+
+void FileSystemCache::invalidate(llvm::StringRef path) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _entries.erase(path);
+  _dir_states.erase(llvm::sys::path::parent_path(path, llvm::sys::path::Style::posix));
+}
+
+void FileSystemCache::load(llvm::StringRef cache_path) {
+  auto buffer = llvm::MemoryBuffer::getFile(cache_path);
+  if (!buffer)
+    return;
+  auto parsed = llvm::json::parse((*buffer)->getBuffer());
+  if (!parsed) {
+    llvm::consumeError(parsed.takeError());
+    return;
+  }
+  auto root = parsed->getAsObject();
+  auto dirs = root ? root->getObject("dirs") : nullptr;
+  if (!dirs)
+    return;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto &[dir_key, value] : *dirs) {
+    llvm::StringRef dir = dir_key;
+    auto dir_entry = value.getAsObject();
+    if (!dir_entry)
+      continue;
+
+    // one stat per directory validates every missing file under it
+    DirState state;
+    state.exists = dir_entry->getBoolean("exists").value_or(true);
+    state.mtime = dir_entry->getInteger("mtime").value_or(0);
+    llvm::sys::fs::file_status status;
+    bool exists = !llvm::sys::fs::status(dir, status) && llvm::sys::fs::is_directory(status);
+    if (exists != state.exists || (exists && to_mtime(status) != state.mtime))
+      continue;
+
+    _dir_states[dir] = state;
+    if (auto missing = dir_entry->getArray("missing")) {
+      for (auto &name : *missing) {
+        if (auto name_str = name.getAsString()) {
+          llvm::SmallString<1024> path(dir);
+          llvm::sys::path::append(path, llvm::sys::path::Style::posix, *name_str);
+          _entries[path].status.reset();
+        }
+      }
+    }
+  }
+}
+llvm::Error FileSystemCache::save(llvm::StringRef cache_path) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  // group missing files by directory
+  llvm::StringMap<std::vector<llvm::StringRef>> missing_files;
+  for (auto &entry : _entries) {
+    if (entry.getValue().status)
+      continue;
+    auto dir = llvm::sys::path::parent_path(entry.getKey(), llvm::sys::path::Style::posix);
+    if (_dir_states.count(dir))
+      missing_files[dir].push_back(llvm::sys::path::filename(entry.getKey(), llvm::sys::path::Style::posix));
+  }
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os(cache_path, ec);
+  if (ec)
+    return llvm::errorCodeToError(ec);
+  llvm::json::OStream stream(os);
+  stream.object([&] {
+    stream.attributeObject("dirs", [&] {
+      for (auto &dir : missing_files) {
+        auto &state = _dir_states.find(dir.getKey())->second;
+        stream.attributeObject(dir.getKey(), [&] {
+          stream.attribute("exists", state.exists);
+          stream.attribute("mtime", state.mtime);
+          stream.attributeArray("missing", [&] {
+            for (auto name : dir.getValue()) {
+              stream.value(name);
+            }
+          });
+        });
+      }
+    });
+  });
+  return llvm::Error::success();
+}
+
+void FileSystemCache::_record_dir_state(llvm::StringRef dir) {
+  if (dir.empty() || _dir_states.count(dir))
+    return;
+  DirState state;
+  llvm::sys::fs::file_status status;
+  state.exists = !llvm::sys::fs::status(dir, status) && llvm::sys::fs::is_directory(status);
+  state.mtime = state.exists ? to_mtime(status) : 0;
+  _dir_states[dir] = state;
+}
+
+CachingFileSystem::CachingFileSystem(llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs, FileSystemCache &cache)
+    : llvm::vfs::ProxyFileSystem(std::move(fs)), _cache(cache) {
+}
+
+llvm::ErrorOr<llvm::vfs::Status> CachingFileSystem::status(const llvm::Twine &path) {
+  auto key = _cache_key(path);
+  if (auto cached = _cache.find_status(key)) {
+    if (!*cached)
+      return cached->getError();
+    return llvm::vfs::Status::copyWithNewName(cached->get(), path);
+  }
+
+  auto result = getUnderlyingFS().status(path);
+  _cache.store_status(key, result);
+  return result;
+}
+
+llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> CachingFileSystem::openFileForRead(const llvm::Twine &path) {
+  auto key = _cache_key(path);
+
+  // known missing
+  auto cached_status = _cache.find_status(key);
+  if (cached_status && !*cached_status)
+    return cached_status->getError();
+
+  // shared content
+  if (_cache.should_cache_content(key)) {
+    auto content = cached_status ? _cache.find_content(key) : nullptr;
+    if (content) {
+      return std::make_unique<CachedFile>(llvm::vfs::Status::copyWithNewName(cached_status->get(), path), content);
+    }
+
+    llvm::ErrorOr<llvm::vfs::Status> status = cached_status ? *cached_status : getUnderlyingFS().status(path);
+    if (!status) {
+      _cache.store_status(key, status);
+      return status.getError();
+    }
+    if (status->isRegularFile()) {
+      auto buffer = getUnderlyingFS().getBufferForFile(path, /*FileSize=*/-1, /*RequiresNullTerminator=*/true, /*IsVolatile=*/false);
+      if (buffer) {
+        _cache.store_status(key, status);
+        auto content = _cache.store_content(key, std::move(*buffer));
+        return std::make_unique<CachedFile>(llvm::vfs::Status::copyWithNewName(*status, path), content);
+      }
+    }
+  }
+
+  // not cached content, only remember status
+  auto file = getUnderlyingFS().openFileForRead(path);
+  if (!file) {
+    _cache.store_status(key, file.getError());
+  } else if (!cached_status) {
+    _cache.store_status(key, (*file)->status());
+  }
+  return file;
+}
+
+std::string CachingFileSystem::_cache_key(const llvm::Twine &path) const {
+  llvm::SmallString<1024> abs_path;
+  path.toVector(abs_path);
+  makeAbsolute(abs_path);
+  llvm::sys::path::remove_dots(abs_path, false);
+  return llvm::sys::path::convert_to_slash(abs_path);
+}
+} // namespace meta
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace meta {
+// stat results and file contents shared by every tool and thread, keyed by absolute path
+class FileSystemCache {
+public:
+  // contents of files under content_dirs are kept in memory (mapped when large)
+  explicit FileSystemCache(std::vector<std::string> content_dirs);
+
+  // cached stat result, nullopt if path has not been seen
+  std::optional<llvm::ErrorOr<llvm::vfs::Status>> find_status(llvm::StringRef path) const;
+  void store_status(llvm::StringRef path, const llvm::ErrorOr<llvm::vfs::Status> &status);
+
+  bool should_cache_content(llvm::StringRef path) const;
+  const llvm::MemoryBuffer *find_content(llvm::StringRef path) const;
+  const llvm::MemoryBuffer *store_content(llvm::StringRef path, std::unique_ptr<llvm::MemoryBuffer> content);
+
+  // drop everything known about path, used when a file changed on disk
+  void invalidate(llvm::StringRef path);
+
+  // persistent cache of missing files, validated by the mtime of their directory
+  void load(llvm::StringRef cache_path);
+  llvm::Error save(llvm::StringRef cache_path) const;
+
+  // statistics
+  size_t hit_count() const { return _hit_count; }
+  size_t miss_count() const { return _miss_count; }
+
+private:
+  struct Entry {
+    std::optional<llvm::vfs::Status> status; // empty for missing file
+    std::unique_ptr<llvm::MemoryBuffer> content;
+  };
+  struct DirState {
+    bool exists = false;
+    int64_t mtime = 0;
+  };
+  void _record_dir_state(llvm::StringRef dir);
+
+  std::vector<std::string> _content_dirs;
+  mutable std::mutex _mutex;
+  llvm::StringMap<Entry> _entries;
+  llvm::StringMap<DirState> _dir_states; // directory state when a missing file under it is found
+  mutable size_t _hit_count = 0;
+  mutable size_t _miss_count = 0;
+};
+
+// vfs layer between ClangTool and the real file system, answers from a shared FileSystemCache
+class CachingFileSystem : public llvm::vfs::ProxyFileSystem {
+public:
+  CachingFileSystem(llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs, FileSystemCache &cache);
+
+  llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine &path) override;
+  llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(const llvm::Twine &path) override;
+
+private:
+  std::string _cache_key(const llvm::Twine &path) const;
+
+  FileSystemCache &_cache;
+};
+} // namespace meta
@@ -0,0 +1,50 @@
+#include "HeaderSchedule.h"
+#include <algorithm>
+
+namespace meta {
+void HeaderSchedule::expect(llvm::StringRef tu, std::vector<std::string> headers, bool is_complete) {
+  if (!is_complete)
+    _incomplete_tus.insert(tu);
+  for (auto &header : headers) {
+    ++_pending[header];
+  }
+  _tu_headers[tu] = std::move(headers);
+}
+
+void HeaderSchedule::produce(llvm::StringRef header) {
+  if (!_released.contains(header))
+    _produced.insert(header);
+}
+
+std::vector<std::string> HeaderSchedule::finish(llvm::StringRef tu) {
+  auto found = _tu_headers.find(tu);
+  if (found != _tu_headers.end()) {
+    for (auto &header : found->second) {
+      --_pending[header];
+    }
+    _tu_headers.erase(found);
+  }
+  _incomplete_tus.erase(tu);
+  return _release(false);
+}
+
+std::vector<std::string> HeaderSchedule::release_remaining() {
+  return _release(true);
+}
+
+std::vector<std::string> HeaderSchedule::_release(bool all) {
+  std::vector<std::string> ready;
+  if (!all && !_incomplete_tus.empty())
+    return ready;
+  for (auto &header : _produced) {
+    if (all || _pending.lookup(header.getKey()) == 0)
+      ready.push_back(header.getKey().str());
+  }
+  for (auto &header : ready) {
+    _produced.erase(header);
+    _released.insert(header);
+  }
+  std::sort(ready.begin(), ready.end());
+  return ready;
+}
+} // namespace meta
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include <string>
+#include <vector>
+
+namespace meta {
+// tells which headers are complete while translation units are still parsed, so they can be written early
+// a header is ready once every translation unit predicted to include it has finished, translation units
+// whose includes are not fully known hold back every header, not thread safe
+// headers are root relative like keys of FileDataMap
+class HeaderSchedule {
+public:
+  void expect(llvm::StringRef tu, std::vector<std::string> headers, bool is_complete);
+
+  // decls of header were merged, by any parse including covering fixup, a released header stays released
+  void produce(llvm::StringRef header);
+  // tu finished, returns produced headers that became ready, each header is released once
+  std::vector<std::string> finish(llvm::StringRef tu);
+  // produced headers not released yet, every header once all translation units finished
+  std::vector<std::string> release_remaining();
+
+  // decls found for a released header came from a mispredicted include and need a rewrite
+  bool is_released(llvm::StringRef header) const { return _released.contains(header); }
+
+private:
+  std::vector<std::string> _release(bool all);
+
+  llvm::StringMap<std::vector<std::string>> _tu_headers;
+  llvm::StringSet<> _incomplete_tus;
+  llvm::StringMap<unsigned> _pending; // header -> unfinished translation units predicted to include it
+  llvm::StringSet<> _produced;        // produced and not released
+  llvm::StringSet<> _released;
+};
+} // namespace meta
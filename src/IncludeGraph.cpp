@@ -0,0 +1,94 @@
+#include "IncludeGraph.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Path.h"
+
+namespace meta {
+std::string normalize_path(llvm::StringRef path) {
+  llvm::SmallString<2048> abs_path(path);
+  if (!llvm::sys::path::is_absolute(abs_path))
+    abs_path = clang::tooling::getAbsolutePath(path);
+  llvm::sys::path::remove_dots(abs_path, true);
+  return llvm::sys::path::convert_to_slash(abs_path.str());
+}
+
+void IncludeGraph::add(llvm::StringRef tu, llvm::StringRef header) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _tu_headers[tu].insert(header);
+  _header_tus[header].insert(tu);
+}
+void IncludeGraph::reset_tu(llvm::StringRef tu) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto found = _tu_headers.find(tu);
+  if (found == _tu_headers.end())
+    return;
+  for (auto &header : found->second) {
+    auto header_found = _header_tus.find(header.getKey());
+    if (header_found != _header_tus.end()) {
+      header_found->second.erase(tu);
+    }
+  }
+  found->second.clear();
+}
+std::vector<std::string> IncludeGraph::tus_of(llvm::StringRef file) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<std::string> result;
+  if (_tu_headers.count(file)) {
+    result.push_back(file.str());
+  }
+  auto found = _header_tus.find(file);
+  if (found != _header_tus.end()) {
+    for (auto &tu : found->second) {
+      if (tu.getKey() != file)
+        result.push_back(tu.getKey().str());
+    }
+  }
+  return result;
+}
+std::vector<std::string> IncludeGraph::headers_of(llvm::StringRef tu) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<std::string> result;
+  auto found = _tu_headers.find(tu);
+  if (found != _tu_headers.end()) {
+    for (auto &header : found->second) {
+      result.push_back(header.getKey().str());
+    }
+  }
+  return result;
+}
+bool IncludeGraph::has_tu(llvm::StringRef tu) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _tu_headers.count(tu);
+}
+std::vector<std::string> IncludeGraph::tus() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<std::string> result;
+  for (auto &entry : _tu_headers) {
+    result.push_back(entry.getKey().str());
+  }
+  return result;
+}
+
+IncludeRecorder::IncludeRecorder(IncludeGraph &graph, clang::SourceManager &sm, std::string tu, std::string root)
+    : _graph(graph), _sm(sm), _tu(std::move(tu)), _root(std::move(root)) {
+  // the main file is a translation unit even if it includes nothing under root
+  _graph.add(_tu, _tu);
+}
+
+void IncludeRecorder::FileChanged(clang::SourceLocation loc, FileChangeReason reason,
+                                  clang::SrcMgr::CharacteristicKind file_type,
+                                  clang::FileID prev_fid) {
+  if (reason != EnterFile)
+    return;
+
+  // same location rule as ASTConsumer::_filter_decl_location
+  clang::PresumedLoc location = _sm.getPresumedLoc(loc);
+  if (location.isInvalid())
+    return;
+  auto file_name = normalize_path(location.getFilename());
+  if (!llvm::StringRef(file_name).starts_with(_root))
+    return;
+
+  _graph.add(_tu, file_name);
+}
+} // namespace meta
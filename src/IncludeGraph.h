@@ -0,0 +1,49 @@
+#pragma once
+
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace meta {
+// make path absolute, remove dots and convert to forward slashes
+std::string normalize_path(llvm::StringRef path);
+
+// translation unit <-> header relation, all paths are normalized absolute paths, thread safe
+class IncludeGraph {
+public:
+  void add(llvm::StringRef tu, llvm::StringRef header);
+  void reset_tu(llvm::StringRef tu);
+
+  // translation units that include the file, or the file itself if it is a translation unit
+  std::vector<std::string> tus_of(llvm::StringRef file) const;
+  std::vector<std::string> headers_of(llvm::StringRef tu) const;
+
+  bool has_tu(llvm::StringRef tu) const;
+  std::vector<std::string> tus() const;
+
+private:
+  mutable std::mutex _mutex;
+  llvm::StringMap<llvm::StringSet<>> _tu_headers;
+  llvm::StringMap<llvm::StringSet<>> _header_tus;
+};
+
+// records every file under root entered by the preprocessor
+class IncludeRecorder : public clang::PPCallbacks {
+public:
+  IncludeRecorder(IncludeGraph &graph, clang::SourceManager &sm, std::string tu, std::string root);
+
+  void FileChanged(clang::SourceLocation loc, FileChangeReason reason,
+                   clang::SrcMgr::CharacteristicKind file_type,
+                   clang::FileID prev_fid) override;
+
+private:
+  IncludeGraph &_graph;
+  clang::SourceManager &_sm;
+  std::string _tu;
+  std::string _root;
+};
+} // namespace meta
@@ -0,0 +1,227 @@
+#include "LayoutReport.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/RecordLayout.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+
+namespace {
+bool is_atomic_type(clang::QualType type) {
+  type = type.getCanonicalType();
+  while (auto array_type = llvm::dyn_cast<clang::ArrayType>(type.getTypePtr())) {
+    type = array_type->getElementType().getCanonicalType();
+  }
+  if (type->isAtomicType())
+    return true;
+  auto record_decl = type->getAsCXXRecordDecl();
+  if (!record_decl)
+    return false;
+  auto name = record_decl->getName();
+  return record_decl->isInStdNamespace() && (name == "atomic" || name == "atomic_ref" || name == "atomic_flag");
+}
+} // namespace
+
+namespace meta {
+LayoutReport::LayoutReport(std::vector<std::string> shared_annotations, std::string count_attr, uint64_t cache_line_size)
+    : _shared_annotations(std::move(shared_annotations)),
+      _count_attr(std::move(count_attr)),
+      _cache_line_size(cache_line_size) {
+}
+
+void LayoutReport::add_record(const clang::CXXRecordDecl *record_decl, clang::ASTContext &ctx,
+                              const std::string &file_name, int line) {
+  if (record_decl->isDependentType() || !record_decl->isCompleteDefinition())
+    return;
+
+  RecordLayoutInfo info;
+  info.name = record_decl->getQualifiedNameAsString();
+  info.file_name = file_name;
+  info.line = line;
+  info.count_hint = _count_hint(record_decl);
+
+  // same record parsed by other translation units
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_records.count(info.name))
+      return;
+  }
+
+  const clang::ASTRecordLayout &layout = ctx.getASTRecordLayout(record_decl);
+  uint64_t char_width = ctx.getCharWidth();
+  info.size = layout.getSize().getQuantity();
+  info.align = layout.getAlignment().getQuantity();
+
+  // bytes taken by vptr and bases, fields are placed after them
+  uint64_t occupied_bits = 0;
+  uint64_t fields_start = 0;
+  if (layout.hasOwnVFPtr()) {
+    occupied_bits += ctx.getTargetInfo().getPointerWidth(clang::LangAS::Default);
+    fields_start = occupied_bits / char_width;
+  }
+  bool can_reorder = record_decl->getNumVBases() == 0;
+  for (auto &base : record_decl->bases()) {
+    auto base_decl = base.getType()->getAsCXXRecordDecl();
+    if (!base_decl || base.isVirtual())
+      continue;
+    if (base_decl->isEmpty())
+      continue;
+    auto &base_layout = ctx.getASTRecordLayout(base_decl);
+    uint64_t base_offset = layout.getBaseClassOffset(base_decl).getQuantity();
+    uint64_t base_data_size = base_layout.getDataSize().getQuantity();
+    occupied_bits += base_data_size * char_width;
+    fields_start = std::max(fields_start, base_offset + base_data_size);
+  }
+
+  // fields
+  for (auto field_decl : record_decl->fields()) {
+    LayoutField field;
+    field.name = field_decl->getNameAsString();
+    field.type = field_decl->getType().getAsString(ctx.getPrintingPolicy());
+    field.offset = layout.getFieldOffset(field_decl->getFieldIndex()) / char_width;
+    field.is_bit_field = field_decl->isBitField();
+    field.is_shared = _is_shared_field(field_decl);
+    if (field.is_bit_field) {
+      uint64_t width = field_decl->getBitWidthValue(ctx);
+      occupied_bits += width;
+      field.size = (width + char_width - 1) / char_width;
+      field.align = 1;
+      can_reorder = false;
+    } else if (field_decl->isZeroSize(ctx)) {
+      field.align = 1;
+    } else {
+      auto type_info = ctx.getTypeInfoInChars(field_decl->getType());
+      field.size = type_info.Width.getQuantity();
+      field.align = ctx.getTypeAlignInChars(field_decl->getType()).getQuantity();
+      if (auto aligned = field_decl->getMaxAlignment())
+        field.align = std::max<uint64_t>(field.align, aligned / char_width);
+      occupied_bits += field.size * char_width;
+    }
+    info.fields.push_back(std::move(field));
+  }
+  uint64_t occupied = (occupied_bits + char_width - 1) / char_width;
+  info.padding = info.size > occupied ? info.size - occupied : 0;
+  info.wasted = info.padding * info.count_hint;
+
+  // suggested order, decreasing alignment then size keeps holes minimal
+  info.optimal_size = info.size;
+  if (can_reorder && !info.fields.empty()) {
+    std::vector<const LayoutField *> order;
+    for (auto &field : info.fields) {
+      order.push_back(&field);
+    }
+    std::stable_sort(order.begin(), order.end(), [](const LayoutField *a, const LayoutField *b) {
+      if (a->align != b->align)
+        return a->align > b->align;
+      return a->size > b->size;
+    });
+    uint64_t offset = fields_start;
+    for (auto field : order) {
+      offset = llvm::alignTo(offset, field->align) + field->size;
+    }
+    uint64_t optimal_size = llvm::alignTo(std::max<uint64_t>(offset, 1), info.align);
+    if (optimal_size < info.size) {
+      info.optimal_size = optimal_size;
+      for (auto field : order) {
+        info.suggested_order.push_back(field->name);
+      }
+    }
+  }
+
+  // shared fields on same cache line
+  std::map<uint64_t, std::vector<std::string>> cache_lines;
+  for (auto &field : info.fields) {
+    if (!field.is_shared)
+      continue;
+    uint64_t first_line = field.offset / _cache_line_size;
+    uint64_t last_line = (field.offset + std::max<uint64_t>(field.size, 1) - 1) / _cache_line_size;
+    for (uint64_t cache_line = first_line; cache_line <= last_line; ++cache_line) {
+      cache_lines[cache_line].push_back(field.name);
+    }
+  }
+  for (auto &[cache_line, fields] : cache_lines) {
+    if (fields.size() > 1)
+      info.false_sharing.push_back({cache_line, fields});
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _records.try_emplace(info.name, std::move(info));
+}
+
+std::vector<RecordLayoutInfo> LayoutReport::sorted_records() const {
+  std::vector<RecordLayoutInfo> records;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto &[name, info] : _records) {
+      records.push_back(info);
+    }
+  }
+  std::stable_sort(records.begin(), records.end(), [](const RecordLayoutInfo &a, const RecordLayoutInfo &b) {
+    return a.wasted > b.wasted;
+  });
+  return records;
+}
+
+llvm::Error LayoutReport::write_json(llvm::StringRef path) const {
+  auto records = sorted_records();
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec);
+  if (ec)
+    return llvm::errorCodeToError(ec);
+  llvm::json::OStream stream(os, 2);
+  stream.object([&] {
+    serde(stream, "records", records);
+  });
+  return llvm::Error::success();
+}
+
+void LayoutReport::print_summary(llvm::raw_ostream &os) const {
+  auto records = sorted_records();
+  uint64_t total_wasted = 0;
+  size_t conflict_count = 0;
+  for (auto &info : records) {
+    if (info.padding == 0 && info.false_sharing.empty())
+      continue;
+    total_wasted += info.wasted;
+    conflict_count += info.false_sharing.size();
+
+    os << "[layout] " << info.name << ": " << info.size << " bytes, " << info.padding << " padding";
+    if (info.count_hint != 1)
+      os << " x " << info.count_hint << " = " << info.wasted;
+    if (!info.suggested_order.empty()) {
+      os << ", " << info.optimal_size << " bytes in order:";
+      for (auto &name : info.suggested_order) {
+        os << " " << name;
+      }
+    }
+    os << "\n";
+    for (auto &conflict : info.false_sharing) {
+      os << "[layout]   cache line " << conflict.cache_line << " shared by";
+      for (auto &name : conflict.fields) {
+        os << " " << name;
+      }
+      os << "\n";
+    }
+  }
+  os << "[layout] " << records.size() << " records, " << total_wasted << " bytes wasted, "
+     << conflict_count << " cache lines shared by atomic or annotated fields\n";
+}
+
+bool LayoutReport::_is_shared_field(const clang::FieldDecl *field_decl) const {
+  if (is_atomic_type(field_decl->getType()))
+    return true;
+  for (auto annotate : field_decl->specific_attrs<clang::AnnotateAttr>()) {
+    if (std::find(_shared_annotations.begin(), _shared_annotations.end(), annotate->getAnnotation()) != _shared_annotations.end())
+      return true;
+  }
+  return false;
+}
+uint64_t LayoutReport::_count_hint(const clang::CXXRecordDecl *record_decl) const {
+  for (auto annotate : record_decl->specific_attrs<clang::AnnotateAttr>()) {
+    auto [name, value] = annotate->getAnnotation().split('=');
+    uint64_t count = 0;
+    if (name.trim() == _count_attr && !value.trim().getAsInteger(10, count))
+      return count;
+  }
+  return 1;
+}
+} // namespace meta
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "serde.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "llvm/Support/Error.h"
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace meta {
+struct LayoutField {
+  std::string name;
+  std::string type;
+  uint64_t offset = 0; // bytes
+  uint64_t size = 0;
+  uint64_t align = 0;
+  bool is_bit_field = false;
+  bool is_shared = false; // atomic or annotated, sensitive to false sharing
+};
+META_SERDE_FUNCTION(LayoutField) {
+  serde_obj(s, key, [&] {
+    META_SERDE(name)
+    META_SERDE(type)
+    META_SERDE(offset)
+    META_SERDE(size)
+    META_SERDE(align)
+    META_SERDE(is_bit_field)
+    META_SERDE(is_shared)
+  });
+}
+
+// shared fields that overlap one cache line
+struct CacheLineConflict {
+  uint64_t cache_line = 0;
+  std::vector<std::string> fields;
+};
+META_SERDE_FUNCTION(CacheLineConflict) {
+  serde_obj(s, key, [&] {
+    META_SERDE(cache_line)
+    META_SERDE(fields)
+  });
+}
+
+struct RecordLayoutInfo {
+  std::string name;
+  std::string file_name;
+  int line = 0;
+
+  uint64_t size = 0;
+  uint64_t align = 0;
+  uint64_t padding = 0;
+  uint64_t optimal_size = 0;
+  uint64_t count_hint = 1;
+  uint64_t wasted = 0; // padding * count_hint
+
+  std::vector<LayoutField> fields;
+  std::vector<std::string> suggested_order; // empty if fields cannot be reordered or order is already optimal
+  std::vector<CacheLineConflict> false_sharing;
+};
+META_SERDE_FUNCTION(RecordLayoutInfo) {
+  serde_obj(s, key, [&] {
+    META_SERDE(name)
+    META_SERDE(file_name)
+    META_SERDE(line)
+
+    META_SERDE(size)
+    META_SERDE(align)
+    META_SERDE(padding)
+    META_SERDE(optimal_size)
+    META_SERDE(count_hint)
+    META_SERDE(wasted)
+
+    META_SERDE(fields)
+    META_SERDE(suggested_order)
+    META_SERDE(false_sharing)
+  });
+}
+
+// layout efficiency of reflected records, collected by ASTConsumer for --layout-report
+class LayoutReport {
+public:
+  // shared_annotations mark fields as sensitive to false sharing besides atomics,
+  // record annotation "<count_attr>=N" gives a hint of how many instances exist
+  LayoutReport(std::vector<std::string> shared_annotations, std::string count_attr, uint64_t cache_line_size = 64);
+
+  void add_record(const clang::CXXRecordDecl *record_decl, clang::ASTContext &ctx,
+                  const std::string &file_name, int line);
+
+  // records sorted by wasted bytes
+  std::vector<RecordLayoutInfo> sorted_records() const;
+  llvm::Error write_json(llvm::StringRef path) const;
+  void print_summary(llvm::raw_ostream &os) const;
+
+private:
+  bool _is_shared_field(const clang::FieldDecl *field_decl) const;
+  uint64_t _count_hint(const clang::CXXRecordDecl *record_decl) const;
+
+  std::vector<std::string> _shared_annotations;
+  std::string _count_attr;
+  uint64_t _cache_line_size;
+
+  mutable std::mutex _mutex;
+  std::map<std::string, RecordLayoutInfo> _records; // keyed by qualified name, a record is seen by many translation units
+};
+} // namespace meta
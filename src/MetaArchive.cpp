@@ -0,0 +1,180 @@
+#include "MetaArchive.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace {
+constexpr llvm::StringLiteral archive_magic = "METAARC1";
+constexpr uint32_t archive_version = 1;
+constexpr size_t header_size = 8 + 4 + 4 + 8;
+
+template <typename T>
+void write_le(llvm::raw_ostream &os, T value) {
+  char bytes[sizeof(T)];
+  llvm::support::endian::write<T, llvm::endianness::little>(bytes, value);
+  os.write(bytes, sizeof(T));
+}
+
+// bounds checked little endian reader over archive buffer
+struct ArchiveCursor {
+  llvm::StringRef data;
+  size_t pos = 0;
+  bool failed = false;
+
+  template <typename T>
+  T read() {
+    if (failed || data.size() - pos < sizeof(T)) {
+      failed = true;
+      return 0;
+    }
+    T value = llvm::support::endian::read<T, llvm::endianness::little>(data.data() + pos);
+    pos += sizeof(T);
+    return value;
+  }
+  llvm::StringRef read_bytes(size_t size) {
+    if (failed || data.size() - pos < size) {
+      failed = true;
+      return {};
+    }
+    auto bytes = data.substr(pos, size);
+    pos += size;
+    return bytes;
+  }
+};
+} // namespace
+
+namespace meta {
+MetaArchiveWriter::MetaArchiveWriter(ArchiveCompression compression)
+    : _compression(compression) {
+  if (_compression == ArchiveCompression::Zstd && !llvm::compression::zstd::isAvailable())
+    _compression = ArchiveCompression::None;
+}
+
+void MetaArchiveWriter::add(llvm::StringRef name, llvm::StringRef content) {
+  Entry entry;
+  entry.name = name.str();
+  entry.raw_size = content.size();
+  entry.compression = _compression;
+  llvm::ArrayRef<uint8_t> raw(content.bytes_begin(), content.size());
+  if (_compression == ArchiveCompression::Zstd) {
+    llvm::SmallVector<uint8_t, 0> compressed;
+    llvm::compression::zstd::compress(raw, compressed);
+    // keep small entries raw if compression doesn't help
+    if (compressed.size() < raw.size()) {
+      entry.data.assign(compressed.begin(), compressed.end());
+    } else {
+      entry.data.assign(raw.begin(), raw.end());
+      entry.compression = ArchiveCompression::None;
+    }
+  } else {
+    entry.data.assign(raw.begin(), raw.end());
+  }
+  _entries.push_back(std::move(entry));
+}
+
+llvm::Error MetaArchiveWriter::write(llvm::StringRef path) const {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec);
+  if (ec)
+    return llvm::createStringError(ec, "failed to open archive " + path);
+
+  // header
+  uint64_t toc_offset = header_size;
+  for (auto &entry : _entries) {
+    toc_offset += entry.data.size();
+  }
+  os << archive_magic;
+  write_le<uint32_t>(os, archive_version);
+  write_le<uint32_t>(os, _entries.size());
+  write_le<uint64_t>(os, toc_offset);
+
+  // data
+  for (auto &entry : _entries) {
+    os.write(reinterpret_cast<const char *>(entry.data.data()), entry.data.size());
+  }
+
+  // toc
+  uint64_t offset = header_size;
+  for (auto &entry : _entries) {
+    write_le<uint32_t>(os, entry.name.size());
+    os << entry.name;
+    write_le<uint64_t>(os, offset);
+    write_le<uint64_t>(os, entry.data.size());
+    write_le<uint64_t>(os, entry.raw_size);
+    write_le<uint8_t>(os, static_cast<uint8_t>(entry.compression));
+    offset += entry.data.size();
+  }
+
+  os.close();
+  if (os.has_error())
+    return llvm::createStringError(os.error(), "failed to write archive " + path);
+  return llvm::Error::success();
+}
+
+llvm::Expected<MetaArchiveReader> MetaArchiveReader::open(llvm::StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+  if (!buffer)
+    return llvm::createStringError(buffer.getError(), "failed to read archive " + path);
+
+  MetaArchiveReader reader;
+  reader._buffer = std::move(*buffer);
+  auto invalid = [&] {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(), "invalid archive " + path);
+  };
+
+  // header
+  ArchiveCursor cursor{reader._buffer->getBuffer()};
+  if (cursor.read_bytes(archive_magic.size()) != archive_magic)
+    return invalid();
+  if (cursor.read<uint32_t>() != archive_version)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(), "unsupported archive version " + path);
+  uint32_t count = cursor.read<uint32_t>();
+  uint64_t toc_offset = cursor.read<uint64_t>();
+  if (cursor.failed || toc_offset > cursor.data.size())
+    return invalid();
+
+  // toc
+  cursor.pos = toc_offset;
+  for (uint32_t i = 0; i < count; ++i) {
+    auto name = cursor.read_bytes(cursor.read<uint32_t>());
+    Entry entry;
+    entry.offset = cursor.read<uint64_t>();
+    entry.stored_size = cursor.read<uint64_t>();
+    entry.raw_size = cursor.read<uint64_t>();
+    entry.compression = static_cast<ArchiveCompression>(cursor.read<uint8_t>());
+    if (cursor.failed || entry.offset > toc_offset || entry.stored_size > toc_offset - entry.offset)
+      return invalid();
+    reader._entries[name] = entry;
+  }
+  return std::move(reader);
+}
+
+std::vector<llvm::StringRef> MetaArchiveReader::names() const {
+  std::vector<llvm::StringRef> result;
+  for (auto &entry : _entries) {
+    result.push_back(entry.getKey());
+  }
+  return result;
+}
+
+llvm::Expected<std::string> MetaArchiveReader::read(llvm::StringRef name) const {
+  auto found = _entries.find(name);
+  if (found == _entries.end())
+    return llvm::createStringError(llvm::inconvertibleErrorCode(), "no archive entry " + name);
+  auto &entry = found->second;
+  auto stored = _buffer->getBuffer().substr(entry.offset, entry.stored_size);
+
+  switch (entry.compression) {
+  case ArchiveCompression::None:
+    return stored.str();
+  case ArchiveCompression::Zstd: {
+    llvm::SmallVector<uint8_t, 0> raw;
+    if (auto err = llvm::compression::zstd::decompress(
+            llvm::ArrayRef<uint8_t>(stored.bytes_begin(), stored.size()), raw, entry.raw_size))
+      return std::move(err);
+    return std::string(raw.begin(), raw.end());
+  }
+  }
+  return llvm::createStringError(llvm::inconvertibleErrorCode(), "unknown compression of archive entry " + name);
+}
+} // namespace meta
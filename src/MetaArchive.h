@@ -0,0 +1,63 @@
+#pragma once
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace meta {
+// single file output, entries are stored back to back and located by a table of contents at the end
+//   header: "METAARC1", u32 version, u32 entry count, u64 toc offset (little endian)
+//   entry data
+//   toc:    per entry u32 name size, name, u64 offset, u64 stored size, u64 raw size, u8 compression
+// each entry is compressed on its own, so one entry can be read without touching the others
+// entry names are relative paths of meta files under the output directory, e.g. "core/object.h.meta"
+enum class ArchiveCompression : uint8_t {
+  None = 0,
+  Zstd = 1,
+};
+
+class MetaArchiveWriter {
+public:
+  // zstd falls back to none if llvm is built without zstd
+  explicit MetaArchiveWriter(ArchiveCompression compression = ArchiveCompression::None);
+
+  void add(llvm::StringRef name, llvm::StringRef content);
+  llvm::Error write(llvm::StringRef path) const;
+
+  ArchiveCompression compression() const { return _compression; }
+
+private:
+  struct Entry {
+    std::string name;
+    std::vector<uint8_t> data;
+    uint64_t raw_size;
+    ArchiveCompression compression;
+  };
+
+  ArchiveCompression _compression;
+  std::vector<Entry> _entries;
+};
+
+class MetaArchiveReader {
+public:
+  static llvm::Expected<MetaArchiveReader> open(llvm::StringRef path);
+
+  std::vector<llvm::StringRef> names() const;
+  bool contains(llvm::StringRef name) const { return _entries.count(name); }
+  llvm::Expected<std::string> read(llvm::StringRef name) const;
+
+private:
+  struct Entry {
+    uint64_t offset;
+    uint64_t stored_size;
+    uint64_t raw_size;
+    ArchiveCompression compression;
+  };
+
+  std::unique_ptr<llvm::MemoryBuffer> _buffer;
+  llvm::StringMap<Entry> _entries;
+};
+} // namespace meta
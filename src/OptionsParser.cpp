@@ -27,10 +27,12 @@
 #include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/Path.h"
+#include <algorithm>
 
 using namespace clang::tooling;
 using namespace llvm;
@@ -68,6 +70,132 @@ static void replaceAll(std::string &str, const std::string &from,
                               // 'x' with 'yx'
   }
 }
+// clang-cl /w, /w1../w4 (with optional warning number), /wd<N>, /we<N> and
+// /wo<N>, not /winsysroot or /winsdkdir which set the system include paths
+static bool isCLLowerWarningFlag(StringRef Arg) {
+  if (!Arg.consume_front("/w"))
+    return false;
+  if (Arg.empty())
+    return true;
+  if (Arg.front() >= '1' && Arg.front() <= '4')
+    Arg = Arg.drop_front();
+  else if (!Arg.consume_front("d") && !Arg.consume_front("e") &&
+           !Arg.consume_front("o"))
+    return false;
+  return llvm::all_of(Arg, isDigit);
+}
+
+static bool isFastParseStrippedFlag(StringRef Arg, bool IsCL) {
+  // warnings, keep -Wl, -Wa, -Wp pass-through
+  if (Arg.starts_with("-W") && !Arg.starts_with("-Wl,") &&
+      !Arg.starts_with("-Wa,") && !Arg.starts_with("-Wp,"))
+    return true;
+  if (Arg == "-w" || Arg.starts_with("-pedantic") || Arg.starts_with("--pedantic"))
+    return true;
+
+  // diagnostics output
+  static const char *const DiagnosticPrefixes[] = {
+      "-fdiagnostics-", "-fno-diagnostics-", "-fcolor-diagnostics",
+      "-fno-color-diagnostics", "-fansi-escape-codes", "-fmessage-length=",
+      "-fcaret-diagnostics", "-fno-caret-diagnostics", "-ferror-limit=",
+      "-ftemplate-backtrace-limit=", "-fmacro-backtrace-limit=",
+      "-fshow-column", "-fno-show-column"};
+  for (auto Prefix : DiagnosticPrefixes)
+    if (Arg.starts_with(Prefix))
+      return true;
+
+  // debug info and codegen only flags, flags that define macros (-O, -fPIC,
+  // -fsanitize, -fstack-protector, ...) are kept to not change preprocessing
+  if (Arg.starts_with("-g") && !Arg.starts_with("-gcc-"))
+    return true;
+  static const char *const CodegenPrefixes[] = {
+      "-fstandalone-debug", "-fno-standalone-debug", "-fdebug-", "-fno-debug-",
+      "-ffunction-sections", "-fno-function-sections", "-fdata-sections",
+      "-fno-data-sections", "-flto", "-fno-lto", "-fprofile-", "-fno-profile-",
+      "-fcoverage-", "-ftest-coverage", "-fomit-frame-pointer",
+      "-fno-omit-frame-pointer"};
+  for (auto Prefix : CodegenPrefixes)
+    if (Arg.starts_with(Prefix))
+      return true;
+
+  // clang-cl spelling
+  if (IsCL) {
+    if (isCLLowerWarningFlag(Arg))
+      return true;
+    static const char *const CLPrefixes[] = {
+        "/W", "/diagnostics:", "/Zi", "/Z7", "/ZI", "/Zd", "/Fd",
+        "/FS", "/Gy", "/Gw", "/GL", "-Zi", "-Z7"};
+    for (auto Prefix : CLPrefixes)
+      if (Arg.starts_with(Prefix))
+        return true;
+  }
+  return false;
+}
+
+static bool isDelayedTemplateParsingSafe(StringRef Std) {
+  // delayed template parsing does not work with C++20 features
+  auto Pos = Std.find("++");
+  if (Pos == StringRef::npos)
+    return true;
+  StringRef Version = Std.substr(Pos + 2);
+  return Version == "98" || Version == "03" || Version == "0x" ||
+         Version == "11" || Version == "1y" || Version == "14" ||
+         Version == "1z" || Version == "17";
+}
+
+ArgumentsAdjuster meta::getFastParseArgumentsAdjuster() {
+  return [](const CommandLineArguments &Args, StringRef /*unused*/) {
+    bool IsCL = false;
+    if (!Args.empty()) {
+      std::string Driver = sys::path::stem(Args[0]).lower();
+      IsCL = Driver == "cl" || Driver == "clang-cl";
+    }
+    for (auto &Arg : Args)
+      if (Arg == "--driver-mode=cl")
+        IsCL = true;
+
+    // arguments after "--" are input files, flags go before it like
+    // getInsertArgumentAdjuster(..., ArgumentInsertPosition::END)
+    size_t End = std::find(Args.begin(), Args.end(), "--") - Args.begin();
+    CommandLineArguments AdjustedArgs;
+    bool DelayTemplates = true;
+    bool HasPrebuiltModules = false;
+    for (size_t i = 0; i < End; ++i) {
+      StringRef Arg = Args[i];
+      if (i == 0) {
+        AdjustedArgs.push_back(Args[i]);
+        continue;
+      }
+
+      // -Xclang <flag>
+      if (Arg == "-Xclang" && i + 1 < End &&
+          isFastParseStrippedFlag(Args[i + 1], IsCL)) {
+        ++i;
+        continue;
+      }
+      if (isFastParseStrippedFlag(Arg, IsCL))
+        continue;
+
+      if (Arg.starts_with("-std=") || Arg.starts_with("--std=") ||
+          Arg.starts_with("/std:") || Arg.starts_with("-std:"))
+        DelayTemplates = isDelayedTemplateParsingSafe(Arg);
+      // prebuilt modules refuse to load with different language options
+      if (Arg.starts_with("-fmodule-file=") ||
+          Arg.starts_with("-fprebuilt-module-path=") ||
+          Arg.starts_with("-fprebuilt-implicit-modules"))
+        HasPrebuiltModules = true;
+      AdjustedArgs.push_back(Args[i]);
+    }
+
+    AdjustedArgs.push_back("-w");
+    // clang-cl already delays template parsing before C++20
+    if (DelayTemplates && !HasPrebuiltModules && !IsCL)
+      AdjustedArgs.push_back("-fdelayed-template-parsing");
+    AdjustedArgs.insert(AdjustedArgs.end(), Args.begin() + End, Args.end());
+    return AdjustedArgs;
+  };
+}
+
 llvm::Error OptionsParser::init(int &argc, const char **argv,
                                 llvm::cl::NumOccurrencesFlag OccurrencesFlag,
                                 cl::OptionCategory &Category,
@@ -95,6 +223,12 @@ llvm::Error OptionsParser::init(int &argc, const char **argv,
       cl::desc("Additional argument to prepend to the compiler command line"),
       cl::cat(Category), cl::sub(cl::SubCommand::getAll()));
 
+  static cl::opt<bool> FastParse(
+      "fast-parse",
+      cl::desc("Strip warning, diagnostic and debug flags from the compiler "
+               "command line and hide diagnostics outside root"),
+      cl::cat(Category), cl::sub(cl::SubCommand::getAll()));
+
   cl::ResetAllOptionOccurrences();
 
   cl::HideUnrelatedOptions(Category);
@@ -130,6 +264,8 @@ llvm::Error OptionsParser::init(int &argc, const char **argv,
   }
 
   cl::PrintOptionValues();
+  if (FastParse)
+    FastParseAdjuster = getFastParseArgumentsAdjuster();
   SourcePathList = SourcePaths;
   if (!SourcePaths.empty()) {
     SmallString<1024> AbsolutePath(getAbsolutePath(SourcePaths[0]));
@@ -69,6 +69,10 @@ public:
   //"--extra-arg-before" options.
   ArgumentsAdjuster getArgumentsAdjuster() { return Adjuster; }
 
+  /// Returns the adjuster of "--fast-parse" profile, which strips warning,
+  /// diagnostic and debug flags. Empty if the profile is not enabled.
+  ArgumentsAdjuster getFastParseAdjuster() { return FastParseAdjuster; }
+
   static const char *const HelpMessage;
 
 private:
@@ -81,6 +85,12 @@ private:
   std::unique_ptr<CompilationDatabase> Compilations;
   std::vector<std::string> SourcePathList;
   ArgumentsAdjuster Adjuster;
+  ArgumentsAdjuster FastParseAdjuster;
 };
 
+/// Gets an argument adjuster which removes flags that only affect warnings,
+/// diagnostics output and codegen, then disables warnings. Delayed template
+/// parsing is enabled when the language standard is older than C++20.
+ArgumentsAdjuster getFastParseArgumentsAdjuster();
+
 } // namespace meta
@@ -0,0 +1,83 @@
+#include "OutputSchema.h"
+#include "meta.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace {
+// struct name -> keys, collected from the serde functions by serializing one value of every struct,
+// a callback field so "functor" is seen and an enum with a value so EnumValue is
+const std::map<std::string, std::set<std::string>> &known_keys() {
+  static const auto keys = [] {
+    meta::SerdeKeyCollector collector;
+    meta::Database tables;
+    tables.signatures.emplace_back();
+    meta::DatabaseStream stream(collector, nullptr, tables);
+
+    meta::Database database{};
+    meta::Record record{};
+    meta::Function function{};
+    meta::Constructor ctor{};
+    meta::Field field{};
+    field.is_callback = true;
+    field.signature = 0;
+    meta::Enum enum_data{};
+    enum_data.values.emplace_back();
+    meta::serde(stream, "", database);
+    meta::serde(stream, "", record);
+    meta::serde(stream, "", function);
+    meta::serde(stream, "", ctor);
+    meta::serde(stream, "", field);
+    meta::serde(stream, "", enum_data);
+    return collector.take();
+  }();
+  return keys;
+}
+} // namespace
+
+namespace meta {
+llvm::Expected<OutputSchema> OutputSchema::load(llvm::StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return llvm::createStringError(buffer.getError(), "failed to read schema " + path);
+  return parse((*buffer)->getBuffer(), path);
+}
+
+llvm::Expected<OutputSchema> OutputSchema::parse(llvm::StringRef json, llvm::StringRef name) {
+  auto error = [&](const llvm::Twine &message) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(), name + ": " + message);
+  };
+
+  auto parsed = llvm::json::parse(json);
+  if (!parsed)
+    return error(llvm::toString(parsed.takeError()));
+  auto root = parsed->getAsObject();
+  if (!root)
+    return error("schema must be an object of struct name to key list");
+
+  // typo in struct or key name would silently keep every key or drop one
+  auto &known = known_keys();
+
+  OutputSchema result;
+  for (auto &[type_key, keys] : *root) {
+    llvm::StringRef type = type_key;
+    auto known_type = known.find(type.str());
+    if (known_type == known.end())
+      return error("unknown struct '" + type + "'");
+    auto key_list = keys.getAsArray();
+    if (!key_list)
+      return error("keys of '" + type + "' must be an array");
+
+    uint64_t type_hash = fnv1a_64(std::string_view(type.data(), type.size()));
+    result._types.insert(type_hash);
+    for (auto &key : *key_list) {
+      auto key_str = key.getAsString();
+      if (!key_str)
+        return error("keys of '" + type + "' must be strings");
+      if (!known_type->second.count(key_str->str()))
+        return error("unknown key '" + *key_str + "' of struct '" + type + "'");
+      result._keys.insert(fnv1a_64(std::string_view(key_str->data(), key_str->size()), fnv1a_64(".", type_hash)));
+    }
+  }
+  return result;
+}
+} // namespace meta
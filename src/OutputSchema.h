@@ -0,0 +1,27 @@
+#pragma once
+
+#include "hash.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Support/Error.h"
+#include <string_view>
+
+namespace meta {
+// keys emitted per serialized struct, loaded from json like
+//   { "Field": ["name", "type", "attrs"], "Function": ["name", "ret_type", "parameters"] }
+// structs not listed keep every key, ASTConsumer does not compute data of dropped keys
+// unknown struct or key names are errors, known ones are collected from the serde functions in meta.h
+class OutputSchema {
+public:
+  static llvm::Expected<OutputSchema> load(llvm::StringRef path);
+  static llvm::Expected<OutputSchema> parse(llvm::StringRef json, llvm::StringRef name);
+
+  bool has(std::string_view type, std::string_view key) const {
+    uint64_t type_hash = fnv1a_64(type);
+    return !_types.contains(type_hash) || _keys.contains(fnv1a_64(key, fnv1a_64(".", type_hash)));
+  }
+
+private:
+  llvm::DenseSet<uint64_t> _types; // fnv1a_64 of listed struct names
+  llvm::DenseSet<uint64_t> _keys;  // fnv1a_64 of "<struct>.<key>"
+};
+} // namespace meta
@@ -0,0 +1,69 @@
+#include "OutputWriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace meta {
+OutputWriter::OutputWriter(unsigned jobs)
+    : _pool(llvm::hardware_concurrency(jobs)) {
+}
+
+void OutputWriter::async(std::function<void()> task) {
+  _pool.async(std::move(task));
+}
+bool OutputWriter::wait() {
+  _pool.wait();
+  return !_failed;
+}
+
+bool OutputWriter::write_file(llvm::StringRef path, llvm::StringRef content) {
+  if (!_ensure_dir(llvm::sys::path::parent_path(path)))
+    return false;
+
+  // content is complete in memory, write it with one unbuffered call
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec);
+  if (ec) {
+    _report("failed to open file: " + path, ec);
+    return false;
+  }
+  os.SetUnbuffered();
+  os << content;
+  os.close();
+  if (os.has_error()) {
+    _report("failed to write file: " + path, os.error());
+    os.clear_error();
+    return false;
+  }
+  return true;
+}
+void OutputWriter::remove_file(llvm::StringRef path) {
+  llvm::sys::fs::remove(path);
+}
+
+bool OutputWriter::_ensure_dir(llvm::StringRef dir) {
+  if (dir.empty())
+    return true;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_created_dirs.count(dir))
+      return true;
+  }
+
+  // racing threads may create the same dir, create_directories accepts existing dirs
+  auto ec = llvm::sys::fs::create_directories(dir);
+  if (ec) {
+    _report("failed to create directory: " + dir, ec);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_mutex);
+  _created_dirs.insert(dir);
+  return true;
+}
+void OutputWriter::_report(const llvm::Twine &message, std::error_code ec) {
+  _failed = true;
+  std::lock_guard<std::mutex> lock(_mutex);
+  llvm::errs() << message << "\n";
+  llvm::errs() << "error: " << ec.message() << "\n";
+}
+} // namespace meta
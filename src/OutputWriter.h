@@ -0,0 +1,33 @@
+#pragma once
+
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/ThreadPool.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+namespace meta {
+// runs serialize & write tasks on a thread pool, directories are created once per run
+class OutputWriter {
+public:
+  // jobs 0 uses all hardware threads
+  explicit OutputWriter(unsigned jobs = 0);
+
+  void async(std::function<void()> task);
+  // wait all tasks, false if any write failed
+  bool wait();
+
+  // thread safe, called from tasks
+  bool write_file(llvm::StringRef path, llvm::StringRef content);
+  void remove_file(llvm::StringRef path);
+
+private:
+  bool _ensure_dir(llvm::StringRef dir);
+  void _report(const llvm::Twine &message, std::error_code ec);
+
+  llvm::ThreadPool _pool;
+  std::mutex _mutex; // guards _created_dirs and error output
+  llvm::StringSet<> _created_dirs;
+  std::atomic<bool> _failed = false;
+};
+} // namespace meta
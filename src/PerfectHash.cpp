@@ -0,0 +1,85 @@
+#include "PerfectHash.h"
+#include "hash.h"
+#include <algorithm>
+#include <numeric>
+
+namespace meta {
+PerfectHash build_perfect_hash(const std::vector<std::string> &keys) {
+  size_t size = keys.size();
+  if (size == 0)
+    return {};
+
+  // unique keys only
+  {
+    std::vector<std::string_view> sorted_keys(keys.begin(), keys.end());
+    std::sort(sorted_keys.begin(), sorted_keys.end());
+    if (std::adjacent_find(sorted_keys.begin(), sorted_keys.end()) != sorted_keys.end())
+      return {};
+  }
+
+  constexpr uint64_t max_seed = 16;
+  constexpr int64_t max_displacement = 1 << 16;
+  for (uint64_t seed = 0; seed < max_seed; ++seed) {
+    PerfectHash result;
+    result.seed = seed;
+    result.displacements.assign(size, 0);
+    result.slots.assign(size, 0);
+
+    // first level buckets, large buckets are placed first
+    std::vector<std::vector<uint32_t>> buckets(size);
+    for (uint32_t i = 0; i < size; ++i) {
+      buckets[perfect_hash(keys[i], seed) % size].push_back(i);
+    }
+    std::vector<size_t> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return buckets[a].size() > buckets[b].size();
+    });
+
+    // find displacement that moves every key of bucket to a free slot
+    std::vector<bool> used(size, false);
+    std::vector<size_t> bucket_slots;
+    bool is_success = true;
+    size_t order_index = 0;
+    for (; order_index < size && buckets[order[order_index]].size() > 1; ++order_index) {
+      auto &bucket = buckets[order[order_index]];
+      int64_t displacement = 1;
+      for (; displacement < max_displacement; ++displacement) {
+        bucket_slots.clear();
+        for (auto key_index : bucket) {
+          size_t slot = perfect_hash(keys[key_index], displacement) % size;
+          if (used[slot] || std::find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end())
+            break;
+          bucket_slots.push_back(slot);
+        }
+        if (bucket_slots.size() == bucket.size())
+          break;
+      }
+      if (displacement == max_displacement) {
+        is_success = false;
+        break;
+      }
+
+      result.displacements[order[order_index]] = displacement;
+      for (size_t i = 0; i < bucket.size(); ++i) {
+        used[bucket_slots[i]] = true;
+        result.slots[bucket_slots[i]] = bucket[i];
+      }
+    }
+    if (!is_success)
+      continue;
+
+    // single key buckets take free slots directly
+    size_t free_slot = 0;
+    for (; order_index < size && buckets[order[order_index]].size() == 1; ++order_index) {
+      while (used[free_slot])
+        ++free_slot;
+      used[free_slot] = true;
+      result.displacements[order[order_index]] = -int64_t(free_slot) - 1;
+      result.slots[free_slot] = buckets[order[order_index]].front();
+    }
+    return result;
+  }
+  return {};
+}
+} // namespace meta
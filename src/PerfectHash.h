@@ -0,0 +1,11 @@
+#pragma once
+
+#include "meta.h"
+#include <string>
+#include <vector>
+
+namespace meta {
+// hash and displace construction of a minimal perfect hash over keys, see hash.h for lookup,
+// returns empty table if keys are empty or not unique
+PerfectHash build_perfect_hash(const std::vector<std::string> &keys);
+} // namespace meta
@@ -0,0 +1,372 @@
+#include "Prescan.h"
+#include "IncludeGraph.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/bit.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define META_PRESCAN_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define META_PRESCAN_NEON 1
+#endif
+
+namespace meta {
+bool contains_marker(llvm::StringRef content, llvm::StringRef marker) {
+  const size_t n = content.size();
+  const size_t k = marker.size();
+  if (k == 0)
+    return true;
+  if (n < k)
+    return false;
+  if (k == 1)
+    return content.find(marker.front()) != llvm::StringRef::npos;
+
+  // compare first & last byte of marker for 16 positions at once, verify candidates with memcmp
+  const char *data = content.data();
+  size_t i = 0;
+#if defined(META_PRESCAN_SSE2)
+  const __m128i first = _mm_set1_epi8(marker.front());
+  const __m128i last = _mm_set1_epi8(marker.back());
+  for (; i + k - 1 + 16 <= n; i += 16) {
+    __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + k - 1));
+    uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                                                    _mm_cmpeq_epi8(last, block_last)));
+    while (mask) {
+      uint32_t bit = llvm::countr_zero(mask);
+      if (std::memcmp(data + i + bit + 1, marker.data() + 1, k - 2) == 0)
+        return true;
+      mask &= mask - 1;
+    }
+  }
+#elif defined(META_PRESCAN_NEON)
+  const uint8x16_t first = vdupq_n_u8(marker.front());
+  const uint8x16_t last = vdupq_n_u8(marker.back());
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  for (; i + k - 1 + 16 <= n; i += 16) {
+    uint8x16_t eq = vandq_u8(vceqq_u8(first, vld1q_u8(bytes + i)),
+                             vceqq_u8(last, vld1q_u8(bytes + i + k - 1)));
+    // narrow to 4 bits per byte
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+    while (mask) {
+      uint32_t bit = llvm::countr_zero(mask) >> 2;
+      if (std::memcmp(data + i + bit + 1, marker.data() + 1, k - 2) == 0)
+        return true;
+      mask &= ~(uint64_t(0xF) << (bit * 4));
+    }
+  }
+#endif
+
+  // tail
+  return content.substr(i).find(marker) != llvm::StringRef::npos;
+}
+
+static void scan_directives(llvm::StringRef content, FileScan &out) {
+  for (size_t pos = content.find('#'); pos != llvm::StringRef::npos; pos = content.find('#', pos + 1)) {
+    // must be the first non blank char of line
+    size_t line_begin = content.rfind('\n', pos);
+    line_begin = line_begin == llvm::StringRef::npos ? 0 : line_begin + 1;
+    if (!content.slice(line_begin, pos).trim().empty())
+      continue;
+
+    // directive name
+    llvm::StringRef rest = content.substr(pos + 1).ltrim(" \t");
+    llvm::StringRef directive = rest.take_while([](char c) { return llvm::isAlpha(c) || c == '_'; });
+    if (directive != "include" && directive != "include_next" && directive != "import")
+      continue;
+
+    // include name
+    rest = rest.drop_front(directive.size()).ltrim(" \t");
+    if (rest.starts_with("\"")) {
+      out.includes.emplace_back(rest.drop_front().take_until([](char c) { return c == '"' || c == '\n'; }).str(), false);
+    } else if (rest.starts_with("<")) {
+      out.includes.emplace_back(rest.drop_front().take_until([](char c) { return c == '>' || c == '\n'; }).str(), true);
+    } else if (directive != "import") {
+      out.has_computed_include = true;
+    }
+  }
+}
+
+Prescanner::Prescanner(std::string root, std::vector<std::string> markers)
+    : _root(std::move(root)), _markers(std::move(markers)) {
+}
+
+const FileScan *Prescanner::scan_file(llvm::StringRef path) {
+  llvm::sys::fs::file_status status;
+  if (llvm::sys::fs::status(path, status) || !llvm::sys::fs::is_regular_file(status)) {
+    _files.erase(path);
+    return nullptr;
+  }
+  uint64_t mtime = status.getLastModificationTime().time_since_epoch().count();
+  uint64_t size = status.getSize();
+
+  // validate cache
+  auto &scan = _files[path];
+  if (scan.mtime == mtime && scan.size == size && mtime != 0) {
+    ++_cached_files;
+    return &scan;
+  }
+
+  // rescan
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false, /*RequiresNullTerminator=*/false);
+  if (!buffer) {
+    _files.erase(path);
+    return nullptr;
+  }
+  ++_scanned_files;
+  scan = FileScan{};
+  scan.mtime = mtime;
+  scan.size = size;
+  llvm::StringRef content = (*buffer)->getBuffer();
+  for (auto &marker : _markers) {
+    if (contains_marker(content, marker)) {
+      scan.has_marker = true;
+      break;
+    }
+  }
+  scan_directives(content, scan);
+  return &scan;
+}
+
+TUScan Prescanner::scan_tu(const clang::tooling::CompileCommand &command, bool follow_outside_root) {
+  TUScan result;
+  auto paths = _parse_search_paths(command);
+
+  llvm::SmallString<1024> main_file(command.Filename);
+  llvm::sys::fs::make_absolute(command.Directory, main_file);
+
+  // walk include closure, files out of root cannot produce reflected decl so we stop there,
+  // unless we want to know the total size of the translation unit
+  std::vector<std::pair<std::string, bool>> stack; // (file, is in scope)
+  llvm::StringSet<> visited;
+  stack.emplace_back(normalize_path(main_file), true);
+  for (auto &forced : paths.forced_includes) {
+    stack.emplace_back(forced, true);
+  }
+  for (auto &[file, in_scope] : stack) {
+    visited.insert(file);
+  }
+  while (!stack.empty()) {
+    auto [file, in_scope] = std::move(stack.back());
+    stack.pop_back();
+
+    const FileScan *scan = scan_file(file);
+    if (!scan) {
+      result.is_complete &= !in_scope;
+      continue;
+    }
+    result.bytes += scan->size;
+    if (in_scope) {
+      result.files.push_back(file);
+      result.has_marker |= scan->has_marker;
+      result.is_complete &= !scan->has_computed_include;
+    }
+
+    llvm::StringRef includer_dir = llvm::sys::path::parent_path(file);
+    for (auto &[name, is_angled] : scan->includes) {
+      auto resolved = _resolve(name, is_angled, includer_dir, paths);
+      if (resolved.empty()) {
+        // angled include that cannot be found is a system header
+        if (in_scope && !is_angled)
+          result.is_complete = false;
+        continue;
+      }
+      bool is_under_root = llvm::StringRef(resolved).starts_with(_root);
+      if (!is_under_root && !follow_outside_root)
+        continue;
+      if (visited.insert(resolved).second)
+        stack.emplace_back(std::move(resolved), is_under_root);
+    }
+  }
+  return result;
+}
+
+void Prescanner::load_cache(llvm::StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return;
+  auto parsed = llvm::json::parse((*buffer)->getBuffer());
+  if (!parsed) {
+    llvm::consumeError(parsed.takeError());
+    return;
+  }
+  auto root = parsed->getAsObject();
+  if (!root)
+    return;
+
+  // cache is useless if markers changed
+  auto markers = root->getArray("markers");
+  if (!markers || markers->size() != _markers.size())
+    return;
+  for (size_t i = 0; i < _markers.size(); ++i) {
+    if ((*markers)[i].getAsString() != llvm::StringRef(_markers[i]))
+      return;
+  }
+
+  auto files = root->getObject("files");
+  if (!files)
+    return;
+  for (auto &[file_path, value] : *files) {
+    auto entry = value.getAsObject();
+    if (!entry)
+      continue;
+    FileScan scan;
+    scan.mtime = entry->getInteger("mtime").value_or(0);
+    scan.size = entry->getInteger("size").value_or(0);
+    scan.has_marker = entry->getBoolean("marker").value_or(true);
+    scan.has_computed_include = entry->getBoolean("computed").value_or(true);
+    if (auto includes = entry->getArray("includes")) {
+      for (auto &include : *includes) {
+        auto pair = include.getAsArray();
+        if (!pair || pair->size() != 2)
+          continue;
+        auto name = (*pair)[0].getAsString();
+        auto is_angled = (*pair)[1].getAsBoolean();
+        if (name && is_angled)
+          scan.includes.emplace_back(name->str(), *is_angled);
+      }
+    }
+    _files[file_path.str()] = std::move(scan);
+  }
+}
+
+llvm::Error Prescanner::save_cache(llvm::StringRef path) const {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec);
+  if (ec)
+    return llvm::errorCodeToError(ec);
+
+  llvm::json::OStream stream(os);
+  stream.object([&] {
+    stream.attributeArray("markers", [&] {
+      for (auto &marker : _markers) {
+        stream.value(marker);
+      }
+    });
+    stream.attributeObject("files", [&] {
+      for (auto &entry : _files) {
+        auto &scan = entry.getValue();
+        stream.attributeObject(entry.getKey(), [&] {
+          stream.attribute("mtime", (int64_t)scan.mtime);
+          stream.attribute("size", (int64_t)scan.size);
+          stream.attribute("marker", scan.has_marker);
+          stream.attribute("computed", scan.has_computed_include);
+          stream.attributeArray("includes", [&] {
+            for (auto &[name, is_angled] : scan.includes) {
+              stream.array([&] {
+                stream.value(name);
+                stream.value(is_angled);
+              });
+            }
+          });
+        });
+      }
+    });
+  });
+  return llvm::Error::success();
+}
+
+Prescanner::SearchPaths Prescanner::_parse_search_paths(const clang::tooling::CompileCommand &command) {
+  auto &args = command.CommandLine;
+
+  // clang-cl style flags
+  bool is_cl = false;
+  if (!args.empty()) {
+    auto driver = llvm::sys::path::stem(args[0]).lower();
+    is_cl = driver == "cl" || driver == "clang-cl";
+  }
+  for (auto &arg : args) {
+    if (arg == "--driver-mode=cl")
+      is_cl = true;
+  }
+
+  std::vector<std::string> quote_dirs, user_dirs, system_dirs, after_dirs;
+  SearchPaths result;
+  auto to_abs = [&](llvm::StringRef path) {
+    llvm::SmallString<1024> abs_path(path);
+    llvm::sys::fs::make_absolute(command.Directory, abs_path);
+    return normalize_path(abs_path);
+  };
+  for (size_t i = 1; i < args.size(); ++i) {
+    llvm::StringRef arg = args[i];
+    auto take = [&](llvm::StringRef flag, std::vector<std::string> &out) {
+      if (!arg.starts_with(flag))
+        return false;
+      llvm::StringRef value = arg.drop_front(flag.size());
+      if (value.empty()) {
+        if (i + 1 >= args.size())
+          return true;
+        value = args[++i];
+      }
+      out.push_back(to_abs(value));
+      return true;
+    };
+    // -include-pch <file> loads a precompiled header, it is no forced include
+    if (arg.starts_with("-include-pch")) {
+      if (arg == "-include-pch")
+        ++i;
+      continue;
+    }
+    if (take("-iquote", quote_dirs) ||
+        take("-isystem", system_dirs) ||
+        take("-idirafter", after_dirs) ||
+        take("-include", result.forced_includes) ||
+        take("-I", user_dirs)) {
+      continue;
+    }
+    if (is_cl) {
+      if (take("-imsvc", system_dirs) ||
+          take("/external:I", system_dirs) ||
+          take("/FI", result.forced_includes) ||
+          take("/I", user_dirs)) {
+        continue;
+      }
+    }
+  }
+
+  result.angled = std::move(user_dirs);
+  result.angled.insert(result.angled.end(), system_dirs.begin(), system_dirs.end());
+  result.angled.insert(result.angled.end(), after_dirs.begin(), after_dirs.end());
+  result.quote = std::move(quote_dirs);
+  result.quote.insert(result.quote.end(), result.angled.begin(), result.angled.end());
+  return result;
+}
+
+std::string Prescanner::_resolve(llvm::StringRef name, bool is_angled, llvm::StringRef includer_dir, const SearchPaths &paths) {
+  auto try_dir = [&](llvm::StringRef dir) -> std::string {
+    llvm::SmallString<1024> candidate(dir);
+    llvm::sys::path::append(candidate, name);
+    llvm::sys::path::remove_dots(candidate, true);
+    std::string path = llvm::sys::path::convert_to_slash(candidate);
+    return _exists(path) ? path : std::string();
+  };
+
+  if (llvm::sys::path::is_absolute(name)) {
+    return try_dir("");
+  }
+  if (!is_angled) {
+    if (auto found = try_dir(includer_dir); !found.empty())
+      return found;
+  }
+  for (auto &dir : is_angled ? paths.angled : paths.quote) {
+    if (auto found = try_dir(dir); !found.empty())
+      return found;
+  }
+  return {};
+}
+
+bool Prescanner::_exists(const std::string &path) {
+  auto [it, inserted] = _exists_cache.try_emplace(path, false);
+  if (inserted)
+    it->second = llvm::sys::fs::is_regular_file(path);
+  return it->second;
+}
+} // namespace meta
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
+#include <string>
+#include <vector>
+
+namespace meta {
+// search marker in buffer, uses SSE2/NEON block compare when available
+bool contains_marker(llvm::StringRef content, llvm::StringRef marker);
+
+// textual facts of one file, cached by path and validated by mtime & size
+struct FileScan {
+  uint64_t mtime = 0;
+  uint64_t size = 0;
+  bool has_marker = false;
+  bool has_computed_include = false; // #include MACRO, cannot be followed textually
+  std::vector<std::pair<std::string, bool>> includes; // (name, is angled)
+};
+
+// textual include closure of one translation unit
+struct TUScan {
+  std::vector<std::string> files; // main file and reached files under root
+  bool has_marker = false;
+  bool is_complete = true; // false if some include under root cannot be followed
+  uint64_t bytes = 0;      // size of scanned files, a cheap estimate of parse cost
+
+  // if false, parsing this translation unit cannot produce any reflected decl
+  bool may_reflect() const { return has_marker || !is_complete; }
+};
+
+class Prescanner {
+public:
+  Prescanner(std::string root, std::vector<std::string> markers);
+
+  const FileScan *scan_file(llvm::StringRef path);
+  // follow_outside_root also walks files out of root to measure bytes, they are not listed in files
+  TUScan scan_tu(const clang::tooling::CompileCommand &command, bool follow_outside_root = false);
+
+  // persistent cache
+  void load_cache(llvm::StringRef path);
+  llvm::Error save_cache(llvm::StringRef path) const;
+
+  // statistics
+  size_t scanned_files() const { return _scanned_files; }
+  size_t cached_files() const { return _cached_files; }
+
+private:
+  struct SearchPaths {
+    std::vector<std::string> quote;
+    std::vector<std::string> angled;
+    std::vector<std::string> forced_includes;
+  };
+  SearchPaths _parse_search_paths(const clang::tooling::CompileCommand &command);
+  std::string _resolve(llvm::StringRef name, bool is_angled, llvm::StringRef includer_dir, const SearchPaths &paths);
+  bool _exists(const std::string &path);
+
+  std::string _root;
+  std::vector<std::string> _markers;
+  llvm::StringMap<FileScan> _files;
+  llvm::StringMap<bool> _exists_cache;
+  size_t _scanned_files = 0;
+  size_t _cached_files = 0;
+};
+} // namespace meta
@@ -0,0 +1,76 @@
+#include "ReflectFilter.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/DeclCXX.h"
+
+namespace meta {
+llvm::Expected<ReflectFilter> ReflectFilter::create(std::string attr_prefix,
+                                                    const std::vector<std::string> &namespace_includes,
+                                                    const std::vector<std::string> &namespace_excludes,
+                                                    std::string member_annotation) {
+  ReflectFilter result;
+  result._attr_prefix = std::move(attr_prefix);
+  result._member_annotation = std::move(member_annotation);
+
+  auto compile = [](const std::vector<std::string> &globs, std::vector<llvm::GlobPattern> &out) -> llvm::Error {
+    for (auto &glob : globs) {
+      auto pattern = llvm::GlobPattern::create(glob);
+      if (!pattern)
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       "invalid namespace glob '" + glob + "': " + llvm::toString(pattern.takeError()));
+      out.push_back(std::move(*pattern));
+    }
+    return llvm::Error::success();
+  };
+  if (auto err = compile(namespace_includes, result._namespace_includes))
+    return std::move(err);
+  if (auto err = compile(namespace_excludes, result._namespace_excludes))
+    return std::move(err);
+  return result;
+}
+
+bool ReflectFilter::is_namespace_excluded(const clang::NamespaceDecl *decl) const {
+  if (_namespace_excludes.empty())
+    return false;
+  return _match_any(_namespace_excludes, decl->getQualifiedNameAsString());
+}
+bool ReflectFilter::accept_namespace_of(const clang::Decl *decl) const {
+  if (_namespace_includes.empty() && _namespace_excludes.empty())
+    return true;
+
+  // innermost namespace, extern "C" blocks are transparent
+  std::string namespace_name;
+  for (auto ctx = decl->getDeclContext(); ctx; ctx = ctx->getParent()) {
+    if (auto namespace_decl = llvm::dyn_cast<clang::NamespaceDecl>(ctx)) {
+      namespace_name = namespace_decl->getQualifiedNameAsString();
+      break;
+    }
+  }
+
+  if (_match_any(_namespace_excludes, namespace_name))
+    return false;
+  return _namespace_includes.empty() || _match_any(_namespace_includes, namespace_name);
+}
+bool ReflectFilter::accept_member(const clang::Decl *decl) const {
+  if (_member_annotation.empty())
+    return true;
+  for (auto annotate : decl->specific_attrs<clang::AnnotateAttr>()) {
+    if (annotate->getAnnotation() == _member_annotation)
+      return true;
+  }
+  return false;
+}
+
+bool ReflectFilter::_match_any(const std::vector<llvm::GlobPattern> &patterns, llvm::StringRef namespace_name) {
+  // "a::b::c" is tested as itself, then "a::b" and "a"
+  while (true) {
+    for (auto &pattern : patterns) {
+      if (pattern.match(namespace_name))
+        return true;
+    }
+    auto pos = namespace_name.rfind("::");
+    if (pos == llvm::StringRef::npos)
+      return false;
+    namespace_name = namespace_name.take_front(pos);
+  }
+}
+} // namespace meta
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "clang/AST/Decl.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/GlobPattern.h"
+#include <string>
+#include <vector>
+
+namespace meta {
+// user narrowing of reflected decls, checked before any member data is computed
+//   attr_prefix       only annotations starting with it are exported as attrs, attributes parse the text after it
+//   namespace globs   matched against the enclosing namespace and its parents, e.g. "game" or "game::*ai*",
+//                     exclude wins over include, decls in global namespace only pass without include globs
+//   member_annotation if set, fields, methods and ctors are reflected only when they carry this annotation
+class ReflectFilter {
+public:
+  static llvm::Expected<ReflectFilter> create(std::string attr_prefix,
+                                              const std::vector<std::string> &namespace_includes,
+                                              const std::vector<std::string> &namespace_excludes,
+                                              std::string member_annotation);
+
+  // the reflect flag itself is never an attr
+  bool is_attr_exported(llvm::StringRef annotation) const {
+    return annotation != "__reflect__" && annotation.starts_with(_attr_prefix);
+  }
+  llvm::StringRef attr_prefix() const { return _attr_prefix; }
+
+  // the whole namespace is excluded, no need to walk into it
+  bool is_namespace_excluded(const clang::NamespaceDecl *decl) const;
+  // decl at namespace scope passes include & exclude globs
+  bool accept_namespace_of(const clang::Decl *decl) const;
+  // member passes opt-in annotation
+  bool accept_member(const clang::Decl *decl) const;
+
+private:
+  static bool _match_any(const std::vector<llvm::GlobPattern> &patterns, llvm::StringRef namespace_name);
+
+  std::string _attr_prefix;
+  std::vector<llvm::GlobPattern> _namespace_includes;
+  std::vector<llvm::GlobPattern> _namespace_excludes;
+  std::string _member_annotation;
+};
+} // namespace meta
@@ -0,0 +1,263 @@
+#include "Reflector.h"
+#include "ASTConsumer.h"
+#include "DiagnosticFilter.h"
+#include "clang/AST/ASTContext.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/MultiplexConsumer.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Serialization/ASTReader.h"
+#include "clang/Serialization/ModuleManager.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/Path.h"
+#include <chrono>
+
+namespace tooling = clang::tooling;
+
+namespace {
+// limits of one translation unit, the first check over a limit reports a fatal error, clang then enters
+// no more includes and instantiates no more templates, and LimitConsumer stops the parser
+class LimitChecker {
+public:
+  LimitChecker(clang::CompilerInstance &compiler, const meta::ReflectorOptions &options)
+      : _compiler(compiler), _options(options), _start(std::chrono::steady_clock::now()) {}
+
+  // false once cancelled
+  bool check() {
+    if (_cancelled)
+      return false;
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _start);
+    if (_options.time_limit_ms && elapsed.count() > _options.time_limit_ms) {
+      _cancel("exceeded time limit of " + std::to_string(_options.time_limit_ms) + "ms");
+      return false;
+    }
+
+    // summing memory walks every file, not needed on each decl
+    if (_options.memory_limit_bytes && ++_checks % 64 == 0) {
+      auto usage = _memory_usage();
+      if (usage > _options.memory_limit_bytes) {
+        _cancel("exceeded memory limit of " + std::to_string(_options.memory_limit_bytes >> 20) + "MB with " +
+                std::to_string(usage >> 20) + "MB");
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool is_cancelled() const { return _cancelled; }
+  const std::string &reason() const { return _reason; }
+
+private:
+  uint64_t _memory_usage() const {
+    auto &source_manager = _compiler.getSourceManager();
+    uint64_t usage = source_manager.getContentCacheSize() + source_manager.getDataStructureSizes();
+    if (_compiler.hasPreprocessor())
+      usage += _compiler.getPreprocessor().getTotalMemory();
+    if (_compiler.hasASTContext())
+      usage += _compiler.getASTContext().getASTAllocatedMemory() + _compiler.getASTContext().getSideTableAllocatedMemory();
+    return usage;
+  }
+  void _cancel(std::string reason) {
+    _cancelled = true;
+    _reason = std::move(reason);
+    auto &diags = _compiler.getDiagnostics();
+    auto diag_id = diags.getCustomDiagID(clang::DiagnosticsEngine::Fatal, "translation unit cancelled: %0");
+    diags.Report(diag_id) << _reason;
+  }
+
+  clang::CompilerInstance &_compiler;
+  const meta::ReflectorOptions &_options;
+  std::chrono::steady_clock::time_point _start;
+  unsigned _checks = 0;
+  bool _cancelled = false;
+  std::string _reason;
+};
+class LimitCallbacks : public clang::PPCallbacks {
+public:
+  explicit LimitCallbacks(LimitChecker &checker)
+      : _checker(checker) {}
+
+  void FileChanged(clang::SourceLocation loc, FileChangeReason reason, clang::SrcMgr::CharacteristicKind file_type,
+                   clang::FileID prev_fid) override {
+    if (reason == EnterFile)
+      _checker.check();
+  }
+
+private:
+  LimitChecker &_checker;
+};
+class LimitConsumer : public clang::ASTConsumer {
+public:
+  explicit LimitConsumer(LimitChecker &checker)
+      : _checker(checker) {}
+
+  // false makes ParseAST return without HandleTranslationUnit
+  bool HandleTopLevelDecl(clang::DeclGroupRef decls) override { return _checker.check(); }
+
+private:
+  LimitChecker &_checker;
+};
+
+class ReflectFrontendAction : public clang::ASTFrontendAction {
+public:
+  ReflectFrontendAction(meta::ReflectResult &result, const meta::ReflectorOptions &options)
+      : _result(result), _options(options) {}
+
+  bool BeginSourceFileAction(clang::CompilerInstance &compiler) override {
+    llvm::SmallString<1024> tu(getCurrentFile());
+    compiler.getFileManager().makeAbsolutePath(tu);
+    _tu_path = meta::normalize_path(tu);
+    _start = std::chrono::steady_clock::now();
+
+    // limits start with the translation unit
+    if (_options.time_limit_ms || _options.memory_limit_bytes) {
+      _limit_checker = std::make_unique<LimitChecker>(compiler, _options);
+      compiler.getPreprocessor().addPPCallbacks(std::make_unique<LimitCallbacks>(*_limit_checker));
+    }
+
+    // watch mode and covering selection need to know which headers each translation unit includes
+    if (_options.include_graph) {
+      compiler.getPreprocessor().addPPCallbacks(std::make_unique<meta::IncludeRecorder>(
+          *_options.include_graph,
+          compiler.getSourceManager(),
+          _tu_path,
+          llvm::sys::path::convert_to_slash(_options.root)));
+    }
+    return true;
+  }
+
+  void EndSourceFileAction() override {
+    auto &compiler = getCompilerInstance();
+    auto elapsed = std::chrono::steady_clock::now() - _start;
+    _result.parse_ms[_tu_path] += std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+    if (_limit_checker && _limit_checker->is_cancelled()) {
+      _result.cancelled.push_back({_tu_path, _limit_checker->reason()});
+    }
+
+    // headers in module files are never entered by the preprocessor, take them from the inputs of each module
+    auto reader = compiler.getASTReader();
+    if (!_options.include_graph || !reader)
+      return;
+    auto root = llvm::sys::path::convert_to_slash(_options.root);
+    for (auto &module_file : reader->getModuleManager()) {
+      reader->visitInputFiles(module_file, false, false, [&](const clang::serialization::InputFile &input, bool is_system) {
+        auto file = input.getFile();
+        if (!file)
+          return;
+        auto path = meta::normalize_path(file->getName());
+        if (llvm::StringRef(path).starts_with(root))
+          _options.include_graph->add(_tu_path, path);
+      });
+    }
+  }
+
+  std::unique_ptr<clang::ASTConsumer>
+  CreateASTConsumer(clang::CompilerInstance &compiler, llvm::StringRef file) override {
+    // fronted opts
+    auto &FO = compiler.getFrontendOpts();
+    FO.SkipFunctionBodies = true;
+    FO.ProgramAction = clang::frontend::ParseSyntaxOnly;
+
+    // lang opts
+    auto &LO = compiler.getLangOpts();
+    LO.CommentOpts.ParseAllComments = true;
+
+    auto consumer = std::make_unique<meta::ASTConsumer>(_result.files, _options.root, _options.layout_report,
+                                                        _options.filter, _options.schema);
+    if (!_limit_checker)
+      return consumer;
+
+    // limit consumer goes first, so a cancelled translation unit is not reflected
+    std::vector<std::unique_ptr<clang::ASTConsumer>> consumers;
+    consumers.push_back(std::make_unique<LimitConsumer>(*_limit_checker));
+    consumers.push_back(std::move(consumer));
+    return std::make_unique<clang::MultiplexConsumer>(std::move(consumers));
+  }
+
+private:
+  meta::ReflectResult &_result;
+  const meta::ReflectorOptions &_options;
+  std::unique_ptr<LimitChecker> _limit_checker;
+  std::string _tu_path; // normalized absolute path
+  std::chrono::steady_clock::time_point _start;
+};
+class ReflectActionFactory : public tooling::FrontendActionFactory {
+public:
+  ReflectActionFactory(meta::ReflectResult &result, const meta::ReflectorOptions &options)
+      : _result(result), _options(options) {}
+
+  std::unique_ptr<clang::FrontendAction> create() override {
+    return std::make_unique<ReflectFrontendAction>(_result, _options);
+  }
+
+private:
+  meta::ReflectResult &_result;
+  const meta::ReflectorOptions &_options;
+};
+} // namespace
+
+namespace meta {
+Reflector::Reflector(const tooling::CompilationDatabase &compilations, ReflectorOptions options)
+    : _compilations(compilations), _options(std::move(options)) {
+}
+
+ReflectResult Reflector::reflect(llvm::ArrayRef<std::string> source_paths, bool fast_parse, bool quiet) const {
+  ReflectResult result;
+  fast_parse &= bool(_options.fast_parse_adjuster);
+
+  // diagnostic consumers live with this call, ClangTool only borrows them
+  auto tool = _create_tool(source_paths, fast_parse);
+  clang::IgnoringDiagConsumer ignore_diagnostics;
+  std::unique_ptr<RootDiagnosticConsumer> root_diagnostics;
+  if (quiet) {
+    tool->setDiagnosticConsumer(&ignore_diagnostics);
+  } else if (fast_parse && _options.filter_diagnostics) {
+    root_diagnostics = std::make_unique<RootDiagnosticConsumer>(llvm::sys::path::convert_to_slash(_options.root));
+    tool->setDiagnosticConsumer(root_diagnostics.get());
+  }
+
+  ReflectActionFactory factory(result, _options);
+  result.status = tool->run(&factory);
+  if (root_diagnostics) {
+    result.suppressed_diagnostics = root_diagnostics->suppressed_count();
+  }
+  for (auto &[file, db] : result.files) {
+    db.canonicalize();
+  }
+  return result;
+}
+
+std::unique_ptr<tooling::ClangTool> Reflector::_create_tool(llvm::ArrayRef<std::string> source_paths, bool fast_parse) const {
+  // file system
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs = llvm::vfs::getRealFileSystem();
+  if (_options.fs_cache) {
+    fs = llvm::makeIntrusiveRefCnt<CachingFileSystem>(std::move(fs), *_options.fs_cache);
+  }
+  auto tool = std::make_unique<tooling::ClangTool>(
+      _compilations, source_paths, std::make_shared<clang::PCHContainerOperations>(), fs);
+
+  // meta def
+  tool->appendArgumentsAdjuster(tooling::getInsertArgumentAdjuster("-D__meta__", tooling::ArgumentInsertPosition::END));
+
+  // clang modules
+  tooling::CommandLineArguments module_args;
+  if (!_options.modules_cache_path.empty()) {
+    module_args.push_back("-fmodules");
+    module_args.push_back("-fimplicit-module-maps");
+    module_args.push_back("-fmodules-cache-path=" + _options.modules_cache_path);
+  }
+  for (auto &path : _options.prebuilt_module_paths) {
+    module_args.push_back("-fprebuilt-module-path=" + path);
+  }
+  if (!module_args.empty()) {
+    tool->appendArgumentsAdjuster(tooling::getInsertArgumentAdjuster(module_args, tooling::ArgumentInsertPosition::END));
+  }
+
+  // fast parse profile
+  if (fast_parse) {
+    tool->appendArgumentsAdjuster(_options.fast_parse_adjuster);
+  }
+  return tool;
+}
+} // namespace meta
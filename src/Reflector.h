@@ -0,0 +1,83 @@
+#pragma once
+
+#include "FileSystemCache.h"
+#include "IncludeGraph.h"
+#include "LayoutReport.h"
+#include "OutputSchema.h"
+#include "ReflectFilter.h"
+#include "meta.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clang::tooling {
+class ClangTool;
+}
+
+namespace meta {
+// everything a parse needs, shared parts are borrowed and must outlive the Reflector
+struct ReflectorOptions {
+  std::string root; // decls out of root are not reflected, keys of FileDataMap are relative to it
+
+  // applied on top of the compile database when fast parse is requested
+  clang::tooling::ArgumentsAdjuster fast_parse_adjuster = {};
+  // only print diagnostics under root when fast parse is used
+  bool filter_diagnostics = true;
+
+  // clang modules, decls of modular headers are deserialized from module files instead of parsed
+  // implicit modules are built into modules_cache_path, it should not be shared with real builds
+  // because function bodies are skipped; explicit module files from the compile database always load
+  std::string modules_cache_path = {};
+  std::vector<std::string> prebuilt_module_paths = {};
+
+  // cooperative limits per translation unit, 0 is unlimited, checked when a file is entered and after each
+  // top level decl, memory is what clang allocated for the source manager, preprocessor and AST
+  // a translation unit over a limit is cancelled with a fatal error, it yields no decls and is listed in ReflectResult
+  unsigned time_limit_ms = 0;
+  uint64_t memory_limit_bytes = 0;
+
+  // optional, all of them are thread safe
+  const ReflectFilter *filter = nullptr;
+  const OutputSchema *schema = nullptr; // data of dropped keys is not computed
+  IncludeGraph *include_graph = nullptr;
+  FileSystemCache *fs_cache = nullptr;
+  LayoutReport *layout_report = nullptr;
+};
+
+// translation unit stopped by ReflectorOptions limits
+struct CancelledTU {
+  std::string tu; // absolute path
+  std::string reason;
+};
+
+// result of one Reflector::reflect call
+struct ReflectResult {
+  FileDataMap files;                   // root relative header -> decls, canonicalized
+  int status = 0;                      // ClangTool::run result, non zero if any translation unit failed
+  unsigned suppressed_diagnostics = 0; // diagnostics out of root hidden by the fast parse profile
+  std::vector<CancelledTU> cancelled;  // also counted as failed in status
+  std::map<std::string, uint64_t> parse_ms; // absolute translation unit path -> time spent parsing it
+};
+
+// parse translation units into databases in memory, the library entry of meta
+// reflect() is thread safe, every call runs its own ClangTool and owns its result
+class Reflector {
+public:
+  Reflector(const clang::tooling::CompilationDatabase &compilations, ReflectorOptions options);
+
+  // quiet drops every diagnostic, fast_parse only works with ReflectorOptions::fast_parse_adjuster
+  ReflectResult reflect(llvm::ArrayRef<std::string> source_paths, bool fast_parse = true, bool quiet = false) const;
+
+  const ReflectorOptions &options() const { return _options; }
+
+private:
+  std::unique_ptr<clang::tooling::ClangTool> _create_tool(llvm::ArrayRef<std::string> source_paths, bool fast_parse) const;
+
+  const clang::tooling::CompilationDatabase &_compilations;
+  ReflectorOptions _options;
+};
+} // namespace meta
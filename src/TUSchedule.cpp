@@ -0,0 +1,204 @@
+#include "TUSchedule.h"
+#include "IncludeGraph.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <optional>
+
+namespace {
+struct WorkItem {
+  std::string tu;   // as given
+  std::string path; // key of TUCostHistory
+  uint64_t cost = 0;
+};
+
+// longest first, equal costs keep their order
+std::vector<WorkItem> sorted_items(llvm::ArrayRef<std::string> tus, const meta::TUCostHistory &history) {
+  std::vector<WorkItem> items;
+  for (auto &tu : tus) {
+    auto path = meta::normalize_path(tu);
+    auto cost = history.cost(path);
+    items.push_back({tu, std::move(path), cost});
+  }
+  std::stable_sort(items.begin(), items.end(), [](auto &a, auto &b) { return a.cost > b.cost; });
+  return items;
+}
+} // namespace
+
+namespace meta {
+void TUCostHistory::load(llvm::StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return;
+  auto parsed = llvm::json::parse((*buffer)->getBuffer());
+  if (!parsed) {
+    llvm::consumeError(parsed.takeError());
+    return;
+  }
+  auto root = parsed->getAsObject();
+  auto tus = root ? root->getObject("tus") : nullptr;
+  if (!tus)
+    return;
+  for (auto &[tu, value] : *tus) {
+    auto entry = value.getAsObject();
+    if (!entry)
+      continue;
+    Entry data;
+    data.ms = entry->getInteger("ms").value_or(0);
+    if (auto headers = entry->getArray("headers")) {
+      for (auto &header : *headers) {
+        if (auto header_path = header.getAsString())
+          data.headers.push_back(header_path->str());
+      }
+    }
+    _max_ms = std::max(_max_ms, data.ms);
+    _entries[tu.str()] = std::move(data);
+  }
+}
+
+llvm::Error TUCostHistory::save(llvm::StringRef path) const {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec);
+  if (ec)
+    return llvm::errorCodeToError(ec);
+
+  llvm::json::OStream stream(os);
+  stream.object([&] {
+    stream.attributeObject("tus", [&] {
+      for (auto &entry : _entries) {
+        auto &data = entry.getValue();
+        stream.attributeObject(entry.getKey(), [&] {
+          stream.attribute("ms", (int64_t)data.ms);
+          stream.attributeArray("headers", [&] {
+            for (auto &header : data.headers) {
+              stream.value(header);
+            }
+          });
+        });
+      }
+    });
+  });
+  return llvm::Error::success();
+}
+
+void TUCostHistory::record(llvm::StringRef tu, uint64_t ms, std::vector<std::string> headers) {
+  auto &entry = _entries[tu];
+  entry.ms = ms;
+  if (!headers.empty())
+    entry.headers = std::move(headers);
+  _max_ms = std::max(_max_ms, ms);
+}
+
+uint64_t TUCostHistory::cost(llvm::StringRef tu) const {
+  auto found = _entries.find(tu);
+  if (found == _entries.end())
+    return std::max<uint64_t>(_max_ms, 1);
+  return found->getValue().ms;
+}
+
+llvm::ArrayRef<std::string> TUCostHistory::headers(llvm::StringRef tu) const {
+  auto found = _entries.find(tu);
+  if (found == _entries.end())
+    return {};
+  return found->getValue().headers;
+}
+
+std::vector<std::string> order_longest_first(llvm::ArrayRef<std::string> tus, const TUCostHistory &history) {
+  std::vector<std::string> result;
+  for (auto &item : sorted_items(tus, history)) {
+    result.push_back(std::move(item.tu));
+  }
+  return result;
+}
+
+std::vector<std::vector<std::string>> schedule_batches(llvm::ArrayRef<std::string> tus,
+                                                       const TUCostHistory &history,
+                                                       size_t batch_count) {
+  auto items = sorted_items(tus, history);
+  uint64_t total_cost = 0;
+  for (auto &item : items) {
+    total_cost += item.cost;
+  }
+  batch_count = std::max<size_t>(batch_count, 1);
+  uint64_t share = std::max<uint64_t>((total_cost + batch_count - 1) / batch_count, 1);
+
+  // header -> items including it, a header of a single translation unit gives no reuse
+  llvm::StringMap<std::vector<size_t>> header_items;
+  for (size_t i = 0; i < items.size(); ++i) {
+    for (auto &header : history.headers(items[i].path)) {
+      header_items[header].push_back(i);
+    }
+  }
+  llvm::StringMap<uint64_t> header_bytes;
+  auto bytes_of = [&](llvm::StringRef header) {
+    auto [found, inserted] = header_bytes.try_emplace(header, 0);
+    if (inserted)
+      llvm::sys::fs::file_size(header, found->second);
+    return found->second;
+  };
+
+  std::vector<bool> assigned(items.size(), false);
+  size_t next = 0; // no unassigned item before it
+  auto next_unassigned = [&]() -> std::optional<size_t> {
+    while (next < items.size() && assigned[next])
+      ++next;
+    return next < items.size() ? std::optional<size_t>(next) : std::nullopt;
+  };
+
+  std::vector<std::pair<uint64_t, std::vector<std::string>>> batches; // (cost, translation units)
+  while (auto seed = next_unassigned()) {
+    std::vector<std::string> batch;
+    uint64_t batch_cost = 0;
+    llvm::StringSet<> batch_headers;
+    llvm::DenseMap<size_t, uint64_t> shared_bytes; // unassigned item -> bytes of headers shared with the batch
+    auto add = [&](size_t i) {
+      assigned[i] = true;
+      shared_bytes.erase(i);
+      batch.push_back(items[i].tu);
+      batch_cost += items[i].cost;
+      for (auto &header : history.headers(items[i].path)) {
+        if (!batch_headers.insert(header).second)
+          continue;
+        auto &includers = header_items[header];
+        if (includers.size() < 2)
+          continue;
+        auto bytes = bytes_of(header);
+        for (auto j : includers) {
+          if (!assigned[j])
+            shared_bytes[j] += bytes;
+        }
+      }
+    };
+
+    add(*seed);
+    while (batch_cost < share) {
+      // most shared header bytes, then longest, without shared headers the longest left
+      std::optional<size_t> best;
+      uint64_t best_bytes = 0;
+      for (auto [i, bytes] : shared_bytes) {
+        if (!best || bytes > best_bytes || (bytes == best_bytes && i < *best)) {
+          best = i;
+          best_bytes = bytes;
+        }
+      }
+      if (!best)
+        best = next_unassigned();
+      if (!best)
+        break;
+      add(*best);
+    }
+    batches.emplace_back(batch_cost, std::move(batch));
+  }
+
+  std::stable_sort(batches.begin(), batches.end(), [](auto &a, auto &b) { return a.first > b.first; });
+  std::vector<std::vector<std::string>> result;
+  for (auto &[cost, batch] : batches) {
+    result.push_back(std::move(batch));
+  }
+  return result;
+}
+} // namespace meta
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Error.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace meta {
+// parse time and included headers of translation units in earlier runs, paths are normalized absolute paths
+class TUCostHistory {
+public:
+  void load(llvm::StringRef path);
+  llvm::Error save(llvm::StringRef path) const;
+
+  // empty headers keep the ones of an earlier parse, include graph is not always recorded
+  void record(llvm::StringRef tu, uint64_t ms, std::vector<std::string> headers);
+
+  // translation units never parsed cost as much as the most expensive known one, so they start early
+  uint64_t cost(llvm::StringRef tu) const;
+  llvm::ArrayRef<std::string> headers(llvm::StringRef tu) const;
+  size_t size() const { return _entries.size(); }
+
+private:
+  struct Entry {
+    uint64_t ms = 0;
+    std::vector<std::string> headers;
+  };
+  llvm::StringMap<Entry> _entries;
+  uint64_t _max_ms = 0;
+};
+
+// longest processing time first, so expensive translation units do not start last and dominate wall time
+std::vector<std::string> order_longest_first(llvm::ArrayRef<std::string> tus, const TUCostHistory &history);
+
+// about batch_count batches for worker processes, longest first, a batch starts with the most expensive translation
+// unit left and takes the ones sharing most header bytes with it, so the file cache of a worker is reused, until it
+// holds its share of the total cost
+std::vector<std::vector<std::string>> schedule_batches(llvm::ArrayRef<std::string> tus,
+                                                       const TUCostHistory &history,
+                                                       size_t batch_count);
+} // namespace meta
@@ -0,0 +1,64 @@
+#include "TUSelection.h"
+#include "llvm/ADT/StringMap.h"
+#include <queue>
+
+namespace meta {
+std::vector<size_t> select_covering_tus(const std::vector<TUCoverage> &candidates) {
+  std::vector<size_t> selected;
+
+  // header -> covered
+  llvm::StringMap<bool> covered;
+  for (auto &candidate : candidates) {
+    for (auto &header : candidate.headers) {
+      covered.try_emplace(header, false);
+    }
+  }
+  auto cover = [&](size_t index) {
+    selected.push_back(index);
+    for (auto &header : candidates[index].headers) {
+      covered[header] = true;
+    }
+  };
+  auto gain = [&](size_t index) {
+    size_t count = 0;
+    for (auto &header : candidates[index].headers) {
+      count += covered[header] ? 0 : 1;
+    }
+    return count;
+  };
+  auto score = [&](size_t index, size_t new_headers) {
+    return double(new_headers) / double(candidates[index].cost + 1);
+  };
+
+  // forced translation units
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (candidates[i].must_select)
+      cover(i);
+  }
+
+  // gain only decreases while selecting, so a stale score in queue is an upper bound (lazy greedy)
+  using QueueItem = std::pair<double, size_t>;
+  std::priority_queue<QueueItem> queue;
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    if (candidates[i].must_select)
+      continue;
+    if (auto new_headers = gain(i))
+      queue.emplace(score(i, new_headers), i);
+  }
+  while (!queue.empty()) {
+    auto [stale_score, index] = queue.top();
+    queue.pop();
+
+    auto new_headers = gain(index);
+    if (new_headers == 0)
+      continue;
+    auto current_score = score(index, new_headers);
+    if (!queue.empty() && current_score < queue.top().first) {
+      queue.emplace(current_score, index);
+      continue;
+    }
+    cover(index);
+  }
+  return selected;
+}
+} // namespace meta
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace meta {
+// what a translation unit can cover, from a textual include scan
+struct TUCoverage {
+  std::string tu;
+  std::vector<std::string> headers; // headers that need to be covered
+  uint64_t cost = 0;
+  bool must_select = false; // include closure is not fully known
+};
+
+// greedy weighted set cover, repeatedly picks the translation unit with the most
+// uncovered headers per cost until every header is covered, returns picked indices
+std::vector<size_t> select_covering_tus(const std::vector<TUCoverage> &candidates);
+} // namespace meta
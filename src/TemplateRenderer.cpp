@@ -0,0 +1,215 @@
+#include "TemplateRenderer.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+namespace {
+bool is_blank(llvm::StringRef text) {
+  return text.find_first_not_of(" \t\r") == llvm::StringRef::npos;
+}
+bool is_truthy(const llvm::json::Value &value) {
+  switch (value.kind()) {
+  case llvm::json::Value::Null:
+    return false;
+  case llvm::json::Value::Boolean:
+    return *value.getAsBoolean();
+  case llvm::json::Value::String:
+    return !value.getAsString()->empty();
+  case llvm::json::Value::Array:
+    return !value.getAsArray()->empty();
+  default:
+    return true;
+  }
+}
+} // namespace
+
+namespace meta {
+struct TemplateRenderer::Scope {
+  const llvm::json::Value *value;
+  const Scope *parent;
+
+  // loop state
+  bool is_loop_item = false;
+  llvm::json::Value index = nullptr;
+  llvm::json::Value first = nullptr;
+  llvm::json::Value last = nullptr;
+};
+
+llvm::Expected<TemplateRenderer> TemplateRenderer::create(llvm::StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return llvm::createStringError(buffer.getError(), "failed to read template " + path);
+  return parse((*buffer)->getBuffer(), path);
+}
+
+llvm::Expected<TemplateRenderer> TemplateRenderer::parse(llvm::StringRef source, llvm::StringRef name) {
+  TemplateRenderer result;
+
+  // open sections, the first one is template root
+  std::vector<Node *> stack;
+  Node root{Node::Section};
+  stack.push_back(&root);
+  auto error = [&](size_t offset, const llvm::Twine &message) {
+    auto line = source.take_front(offset).count('\n') + 1;
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   name + ":" + llvm::Twine(line) + ": " + message);
+  };
+
+  size_t pos = 0;
+  bool line_is_blank = true; // only whitespace since last line break
+  while (pos < source.size()) {
+    size_t open = source.find("{{", pos);
+    if (open == llvm::StringRef::npos)
+      open = source.size();
+    auto text = source.slice(pos, open);
+    if (open == source.size()) {
+      stack.back()->children.push_back({Node::Text, text.str()});
+      break;
+    }
+    size_t close = source.find("}}", open + 2);
+    if (close == llvm::StringRef::npos)
+      return error(open, "unclosed tag");
+    auto tag = source.slice(open + 2, close).trim();
+    pos = close + 2;
+
+    // tag kind
+    char sigil = tag.empty() ? 0 : tag.front();
+    bool is_block_tag = sigil == '#' || sigil == '^' || sigil == '/' || sigil == '!';
+    if (sigil == '#' || sigil == '^' || sigil == '/' || sigil == '!')
+      tag = tag.drop_front().trim();
+
+    // standalone block tag, remove its whole line
+    auto line_start = text.rfind('\n');
+    bool blank_before = line_start == llvm::StringRef::npos
+                            ? line_is_blank && is_blank(text)
+                            : is_blank(text.drop_front(line_start + 1));
+    auto line_end = source.find('\n', pos);
+    auto after = source.slice(pos, line_end);
+    if (is_block_tag && blank_before && is_blank(after)) {
+      text = line_start == llvm::StringRef::npos ? text.take_front(0) : text.take_front(line_start + 1);
+      pos = line_end == llvm::StringRef::npos ? source.size() : line_end + 1;
+      line_is_blank = true;
+    } else {
+      line_is_blank = false;
+    }
+    if (!text.empty())
+      stack.back()->children.push_back({Node::Text, text.str()});
+
+    // build node
+    switch (sigil) {
+    case '!':
+      break;
+    case '#':
+    case '^': {
+      if (tag.empty())
+        return error(open, "section without name");
+      stack.back()->children.push_back({sigil == '#' ? Node::Section : Node::InvertedSection, tag.str()});
+      stack.push_back(&stack.back()->children.back());
+      break;
+    }
+    case '/':
+      if (stack.size() == 1 || stack.back()->text != tag)
+        return error(open, "unexpected {{/" + tag + "}}");
+      stack.pop_back();
+      break;
+    default:
+      if (tag.empty())
+        return error(open, "empty tag");
+      stack.back()->children.push_back({Node::Variable, tag.str()});
+      break;
+    }
+  }
+  if (stack.size() != 1)
+    return error(source.size(), "unclosed section {{#" + stack.back()->text + "}}");
+
+  result._nodes = std::move(root.children);
+  return std::move(result);
+}
+
+std::string TemplateRenderer::render(const llvm::json::Value &context) const {
+  std::string out;
+  Scope scope{&context, nullptr};
+  _render(_nodes, &scope, out);
+  return out;
+}
+
+const llvm::json::Value *TemplateRenderer::_lookup(const Scope *scope, llvm::StringRef name) {
+  if (name == ".")
+    return scope->value;
+
+  // loop state
+  if (name.starts_with("@")) {
+    for (; scope; scope = scope->parent) {
+      if (!scope->is_loop_item)
+        continue;
+      if (name == "@index")
+        return &scope->index;
+      if (name == "@first")
+        return &scope->first;
+      if (name == "@last")
+        return &scope->last;
+      return nullptr;
+    }
+    return nullptr;
+  }
+
+  // first part is searched from innermost scope, the rest is member access
+  auto [head, rest] = name.split('.');
+  const llvm::json::Value *found = nullptr;
+  for (; scope && !found; scope = scope->parent) {
+    if (auto object = scope->value->getAsObject())
+      found = object->get(head);
+  }
+  while (found && !rest.empty()) {
+    std::tie(head, rest) = rest.split('.');
+    auto object = found->getAsObject();
+    found = object ? object->get(head) : nullptr;
+  }
+  return found;
+}
+
+void TemplateRenderer::_render(const std::vector<Node> &nodes, const Scope *scope, std::string &out) {
+  for (auto &node : nodes) {
+    switch (node.kind) {
+    case Node::Text:
+      out += node.text;
+      break;
+    case Node::Variable: {
+      auto value = _lookup(scope, node.text);
+      if (!value)
+        break;
+      if (auto str = value->getAsString()) {
+        out += *str;
+      } else if (auto integer = value->getAsUINT64()) {
+        out += std::to_string(*integer);
+      } else if (auto integer = value->getAsInteger()) {
+        out += std::to_string(*integer);
+      } else if (value->kind() != llvm::json::Value::Null) {
+        out += llvm::formatv("{0}", *value).str();
+      }
+      break;
+    }
+    case Node::Section: {
+      auto value = _lookup(scope, node.text);
+      if (!value || !is_truthy(*value))
+        break;
+      if (auto array = value->getAsArray()) {
+        for (size_t i = 0; i < array->size(); ++i) {
+          Scope item{&(*array)[i], scope, true, int64_t(i), i == 0, i + 1 == array->size()};
+          _render(node.children, &item, out);
+        }
+      } else {
+        Scope item{value, scope};
+        _render(node.children, &item, out);
+      }
+      break;
+    }
+    case Node::InvertedSection: {
+      auto value = _lookup(scope, node.text);
+      if (!value || !is_truthy(*value))
+        _render(node.children, scope, out);
+      break;
+    }
+    }
+  }
+}
+} // namespace meta
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "llvm/Support/Error.h"
+#include "llvm/Support/JSON.h"
+#include <string>
+#include <vector>
+
+namespace meta {
+// mustache like text template rendered over json value
+//   {{name}}             value of name, looked up from innermost scope, dotted path allowed, {{.}} is current value
+//   {{#name}}..{{/name}} loop over array, enter object, or render once if value is truthy
+//   {{^name}}..{{/name}} render if value is missing, false, null, empty string or empty array
+//   {{! comment}}
+// inside loop {{@index}}, {{@first}} and {{@last}} are available, text is not escaped,
+// lines that only contain a section or comment tag are removed from output
+class TemplateRenderer {
+public:
+  static llvm::Expected<TemplateRenderer> create(llvm::StringRef path);
+  static llvm::Expected<TemplateRenderer> parse(llvm::StringRef source, llvm::StringRef name);
+
+  std::string render(const llvm::json::Value &context) const;
+
+private:
+  struct Node {
+    enum Kind {
+      Text,
+      Variable,
+      Section,
+      InvertedSection,
+    };
+    Kind kind;
+    std::string text; // text or name
+    std::vector<Node> children;
+  };
+  struct Scope;
+
+  static const llvm::json::Value *_lookup(const Scope *scope, llvm::StringRef name);
+  static void _render(const std::vector<Node> &nodes, const Scope *scope, std::string &out);
+
+  std::vector<Node> _nodes;
+};
+} // namespace meta
@@ -0,0 +1,117 @@
+#include "Watcher.h"
+#include "IncludeGraph.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace meta {
+Watcher::Watcher(std::string root)
+    : _root(std::move(root)) {
+}
+Watcher::~Watcher() {
+#ifdef __linux__
+  if (_fd >= 0)
+    close(_fd);
+#endif
+}
+
+llvm::Error Watcher::start() {
+#ifdef __linux__
+  _fd = inotify_init1(IN_CLOEXEC);
+  if (_fd < 0) {
+    return llvm::errorCodeToError(std::error_code(errno, std::generic_category()));
+  }
+  _add_watch_recursive(_root);
+  if (_watch_dirs.empty()) {
+    return llvm::make_error<llvm::StringError>(
+        "failed to watch root directory: " + _root, llvm::inconvertibleErrorCode());
+  }
+  return llvm::Error::success();
+#else
+  return llvm::make_error<llvm::StringError>(
+      "watch mode is only supported on linux (inotify)", llvm::inconvertibleErrorCode());
+#endif
+}
+
+std::vector<std::string> Watcher::wait_changes(std::chrono::milliseconds debounce) {
+  std::vector<std::string> changes;
+#ifdef __linux__
+  // wait for first event
+  while (changes.empty()) {
+    pollfd fds = {_fd, POLLIN, 0};
+    if (poll(&fds, 1, -1) <= 0) {
+      if (errno == EINTR)
+        continue;
+      return changes;
+    }
+    _read_events(changes);
+  }
+
+  // editors save with several events (truncate, write, rename), wait until quiet
+  while (true) {
+    pollfd fds = {_fd, POLLIN, 0};
+    if (poll(&fds, 1, (int)debounce.count()) <= 0)
+      break;
+    _read_events(changes);
+  }
+
+  std::sort(changes.begin(), changes.end());
+  changes.erase(std::unique(changes.begin(), changes.end()), changes.end());
+#endif
+  return changes;
+}
+
+void Watcher::_add_watch_recursive(const std::string &dir) {
+#ifdef __linux__
+  const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+  int wd = inotify_add_watch(_fd, dir.c_str(), mask);
+  if (wd < 0)
+    return;
+  _watch_dirs[wd] = dir;
+
+  std::error_code ec;
+  for (llvm::sys::fs::recursive_directory_iterator it(dir, ec), end; it != end && !ec; it.increment(ec)) {
+    if (it->type() != llvm::sys::fs::file_type::directory_file)
+      continue;
+    int child_wd = inotify_add_watch(_fd, it->path().c_str(), mask);
+    if (child_wd >= 0)
+      _watch_dirs[child_wd] = it->path();
+  }
+#endif
+}
+
+void Watcher::_read_events(std::vector<std::string> &out_changes) {
+#ifdef __linux__
+  alignas(inotify_event) char buffer[64 * 1024];
+  ssize_t len = read(_fd, buffer, sizeof(buffer));
+  if (len <= 0)
+    return;
+
+  for (char *ptr = buffer; ptr < buffer + len;) {
+    auto event = reinterpret_cast<const inotify_event *>(ptr);
+    ptr += sizeof(inotify_event) + event->len;
+
+    auto found = _watch_dirs.find(event->wd);
+    if (found == _watch_dirs.end() || event->len == 0)
+      continue;
+
+    llvm::SmallString<1024> path(found->second);
+    llvm::sys::path::append(path, event->name);
+
+    // new directory, watch it and its content
+    if (event->mask & IN_ISDIR) {
+      if (event->mask & (IN_CREATE | IN_MOVED_TO))
+        _add_watch_recursive(path.str().str());
+      continue;
+    }
+    out_changes.push_back(normalize_path(path));
+  }
+#endif
+}
+} // namespace meta
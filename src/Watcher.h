@@ -0,0 +1,29 @@
+#pragma once
+
+#include "llvm/Support/Error.h"
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace meta {
+// watches every directory under root for saved files, backed by inotify
+class Watcher {
+public:
+  explicit Watcher(std::string root);
+  ~Watcher();
+
+  llvm::Error start();
+
+  // block until files changed, then collect more changes until the directory is quiet for debounce
+  std::vector<std::string> wait_changes(std::chrono::milliseconds debounce);
+
+private:
+  void _add_watch_recursive(const std::string &dir);
+  void _read_events(std::vector<std::string> &out_changes);
+
+  std::string _root;
+  int _fd = -1;
+  std::unordered_map<int, std::string> _watch_dirs;
+};
+} // namespace meta
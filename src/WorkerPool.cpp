@@ -0,0 +1,217 @@
+#include "WorkerPool.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <thread>
+
+namespace {
+struct RunningWorker {
+  llvm::sys::ProcessInfo process;
+  std::vector<std::string> batch;
+  llvm::SmallString<128> batch_path;
+  llvm::SmallString<128> spool_path;
+};
+
+// spool of an exited worker, nothing if it is missing or truncated
+std::optional<llvm::json::Value> read_spool(llvm::StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  if (!buffer)
+    return std::nullopt;
+  auto value = llvm::json::parse((*buffer)->getBuffer());
+  if (!value) {
+    llvm::consumeError(value.takeError());
+    return std::nullopt;
+  }
+  return std::move(*value);
+}
+} // namespace
+
+namespace meta {
+llvm::json::Value encode_worker_result(const ReflectResult &result, const IncludeGraph &graph) {
+  llvm::json::Object files;
+  for (auto &[file, db] : result.files) {
+    files[file] = db.to_json();
+  }
+  llvm::json::Array cancelled;
+  for (auto &tu : result.cancelled) {
+    cancelled.push_back(llvm::json::Object{{"tu", tu.tu}, {"reason", tu.reason}});
+  }
+  llvm::json::Object parse_ms;
+  for (auto &[tu, ms] : result.parse_ms) {
+    parse_ms[tu] = ms;
+  }
+  llvm::json::Object includes;
+  for (auto &tu : graph.tus()) {
+    llvm::json::Array headers;
+    for (auto &header : graph.headers_of(tu)) {
+      headers.push_back(header);
+    }
+    includes[tu] = std::move(headers);
+  }
+  return llvm::json::Object{
+      {"status", result.status},
+      {"suppressed_diagnostics", result.suppressed_diagnostics},
+      {"files", std::move(files)},
+      {"cancelled", std::move(cancelled)},
+      {"parse_ms", std::move(parse_ms)},
+      {"includes", std::move(includes)},
+  };
+}
+
+bool decode_worker_result(const llvm::json::Value &spool, ReflectResult &out_result, IncludeGraph &out_graph) {
+  auto object = spool.getAsObject();
+  if (!object)
+    return false;
+  auto status = object->getInteger("status");
+  auto files = object->getObject("files");
+  if (!status || !files)
+    return false;
+
+  out_result.status = int(*status);
+  out_result.suppressed_diagnostics = unsigned(object->getInteger("suppressed_diagnostics").value_or(0));
+  for (auto &[file, db] : *files) {
+    out_result.files[file.str()] = Database::from_json(db);
+  }
+  if (auto cancelled = object->getArray("cancelled")) {
+    for (auto &item : *cancelled) {
+      auto tu = item.getAsObject();
+      if (!tu)
+        continue;
+      out_result.cancelled.push_back({tu->getString("tu").value_or("").str(),
+                                      tu->getString("reason").value_or("").str()});
+    }
+  }
+  if (auto parse_ms = object->getObject("parse_ms")) {
+    for (auto &[tu, ms] : *parse_ms) {
+      out_result.parse_ms[tu.str()] = ms.getAsUINT64().value_or(0);
+    }
+  }
+  if (auto includes = object->getObject("includes")) {
+    for (auto &[tu, headers] : *includes) {
+      auto array = headers.getAsArray();
+      if (!array)
+        continue;
+      for (auto &header : *array) {
+        if (auto path = header.getAsString())
+          out_graph.add(tu, *path);
+      }
+    }
+  }
+  return true;
+}
+
+WorkerPool::WorkerPool(std::string executable, std::vector<std::string> args, unsigned workers)
+    : _executable(std::move(executable)),
+      _args(std::move(args)),
+      _workers(workers ? workers : llvm::hardware_concurrency().compute_thread_count()) {}
+
+std::vector<std::string> WorkerPool::run(std::vector<std::vector<std::string>> batches, ResultHandler on_result) {
+  std::deque<std::vector<std::string>> queue(std::make_move_iterator(batches.begin()),
+                                             std::make_move_iterator(batches.end()));
+  std::vector<RunningWorker> running;
+  std::vector<std::string> failed;
+
+  // split a failed batch to retry every translation unit on its own, a single one is given up
+  auto fail = [&](std::vector<std::string> &batch, const llvm::Twine &reason) {
+    if (batch.size() > 1) {
+      llvm::errs() << "[worker] batch of " << batch.size() << " translation units failed, " << reason
+                   << ", retrying them one by one\n";
+      for (auto &tu : batch) {
+        queue.push_back({tu});
+      }
+      return;
+    }
+    llvm::errs() << "[worker] " << batch.front() << " failed, " << reason << "\n";
+    failed.push_back(batch.front());
+  };
+  auto remove_files = [](RunningWorker &worker) {
+    llvm::sys::fs::remove(worker.batch_path);
+    llvm::sys::fs::remove(worker.spool_path);
+  };
+
+  while (!queue.empty() || !running.empty()) {
+    // start workers, a new process replaces a crashed one
+    while (running.size() < _workers && !queue.empty()) {
+      RunningWorker worker;
+      worker.batch = std::move(queue.front());
+      queue.pop_front();
+
+      // batch file lists translation units line by line, the spool stays empty unless the worker completes
+      int batch_fd = -1;
+      if (auto ec = llvm::sys::fs::createTemporaryFile("meta-batch", "txt", batch_fd, worker.batch_path)) {
+        fail(worker.batch, "cannot create batch file: " + ec.message());
+        continue;
+      }
+      {
+        llvm::raw_fd_ostream os(batch_fd, true);
+        for (auto &tu : worker.batch) {
+          os << tu << "\n";
+        }
+      }
+      if (auto ec = llvm::sys::fs::createTemporaryFile("meta-spool", "json", worker.spool_path)) {
+        llvm::sys::fs::remove(worker.batch_path);
+        fail(worker.batch, "cannot create spool file: " + ec.message());
+        continue;
+      }
+
+      // worker args go first, args after "--" are compiler arguments
+      std::vector<std::string> arg_storage{
+          _executable,
+          ("--worker-batch=" + llvm::Twine(worker.batch_path)).str(),
+          ("--worker-output=" + llvm::Twine(worker.spool_path)).str(),
+      };
+      arg_storage.insert(arg_storage.end(), _args.begin(), _args.end());
+      std::vector<llvm::StringRef> argv(arg_storage.begin(), arg_storage.end());
+
+      // progress output of workers is dropped, diagnostics go to stderr
+      std::optional<llvm::StringRef> redirects[] = {std::nullopt, llvm::StringRef(""), std::nullopt};
+      std::string error;
+      bool execution_failed = false;
+      worker.process = llvm::sys::ExecuteNoWait(_executable, argv, std::nullopt, redirects, 0, &error,
+                                                &execution_failed);
+      if (execution_failed) {
+        remove_files(worker);
+        llvm::errs() << "[worker] failed to start " << _executable << ": " << error << "\n";
+        failed.insert(failed.end(), worker.batch.begin(), worker.batch.end());
+        continue;
+      }
+      running.push_back(std::move(worker));
+    }
+
+    // collect exited workers
+    bool any_exited = false;
+    for (size_t i = 0; i < running.size();) {
+      auto &worker = running[i];
+      std::string error;
+      auto info = llvm::sys::Wait(worker.process, 0, &error);
+      if (info.Pid == 0) {
+        ++i;
+        continue;
+      }
+
+      any_exited = true;
+      auto spool = read_spool(worker.spool_path);
+      if (!spool) {
+        // -2 is a crash or signal, -1 a failed exec
+        if (info.ReturnCode < 0)
+          fail(worker.batch, "crashed" + (error.empty() ? llvm::Twine() : ": " + llvm::Twine(error)));
+        else
+          fail(worker.batch, "exit code " + llvm::Twine(info.ReturnCode) + " without result");
+      } else if (!on_result(worker.batch, *spool)) {
+        fail(worker.batch, "incomplete result");
+      }
+      remove_files(worker);
+      running.erase(running.begin() + i);
+    }
+    if (!any_exited)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return failed;
+}
+} // namespace meta
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "IncludeGraph.h"
+#include "Reflector.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/Support/JSON.h"
+#include <string>
+#include <vector>
+
+namespace meta {
+// spool file of a worker process, decls of every header, cancelled translation units, parse times and the include graph
+llvm::json::Value encode_worker_result(const ReflectResult &result, const IncludeGraph &graph);
+// false if the spool was not completely written, includes are added to out_graph
+bool decode_worker_result(const llvm::json::Value &spool, ReflectResult &out_result, IncludeGraph &out_graph);
+
+// parses batches of translation units in child processes of the meta executable, so a crash in clang only
+// loses the batch of its worker, a crashed batch is retried with a process per translation unit to isolate it
+// workers write their result to a spool file, the LLVM process API redirects output only to files
+class WorkerPool {
+public:
+  // args are passed to every worker after --worker-batch and --worker-output, workers 0 uses all hardware threads
+  WorkerPool(std::string executable, std::vector<std::string> args, unsigned workers);
+
+  // called on the thread of run() when a worker finished its batch, false fails the batch like a crash
+  using ResultHandler = llvm::function_ref<bool(llvm::ArrayRef<std::string> batch, const llvm::json::Value &spool)>;
+
+  // returns translation units that failed their worker on their own
+  std::vector<std::string> run(std::vector<std::vector<std::string>> batches, ResultHandler on_result);
+
+private:
+  std::string _executable;
+  std::vector<std::string> _args;
+  unsigned _workers;
+};
+} // namespace meta
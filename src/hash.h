@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace meta {
+// FNV-1a 64, the algorithm of type_hash emitted in meta files:
+//   hash = 0xcbf29ce484222325
+//   for each byte of text: hash = (hash ^ byte) * 0x100000001b3 (mod 2^64)
+// type_hash is computed over the canonical qualified type name without cv-qualifiers,
+// e.g. "ns::Foo", "int", "unsigned long long", "(anonymous namespace)::Bar",
+// generated code can embed the emitted value or call this function in constant evaluation
+constexpr uint64_t fnv1a_64(std::string_view text, uint64_t hash = 0xcbf29ce484222325ull) {
+  for (char c : text) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+} // namespace meta
+
+namespace meta {
+// minimal perfect hash emitted as value_hash of enums and field_hash of records, keys are unqualified names:
+//   bucket = perfect_hash(key, seed) % size
+//   d = displacements[bucket]
+//   slot = d < 0 ? -d - 1 : perfect_hash(key, d) % size
+//   index = slots[slot], then compare key with the name at index to reject unknown keys
+// perfect_hash is fnv1a_64 with basis 0xcbf29ce484222325 ^ x followed by splitmix64 finalizer,
+// low bits of plain FNV-1a are too weak for small tables
+constexpr uint64_t perfect_hash(std::string_view key, uint64_t x) {
+  uint64_t hash = fnv1a_64(key, 0xcbf29ce484222325ull ^ x);
+  hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+  hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebull;
+  return hash ^ (hash >> 31);
+}
+constexpr size_t perfect_hash_slot(std::string_view key, uint64_t seed, const int64_t *displacements, size_t size) {
+  int64_t d = displacements[perfect_hash(key, seed) % size];
+  return d < 0 ? size_t(-d - 1) : size_t(perfect_hash(key, uint64_t(d)) % size);
+}
+} // namespace meta
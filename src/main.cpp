@@ -1,21 +1,37 @@
-// Declares clang::SyntaxOnlyAction.
-#include "clang/AST/Decl.h"
-#include "clang/Frontend/CompilerInstance.h"
-#include "clang/Frontend/FrontendActions.h"
-#include "clang/Tooling/CommonOptionsParser.h"
 #include "clang/Tooling/Tooling.h"
 
 // Declares llvm::cl::extrahelp.
-#include "ASTConsumer.h"
+#include "FileSystemCache.h"
+#include "HeaderSchedule.h"
+#include "IncludeGraph.h"
+#include "LayoutReport.h"
+#include "MetaArchive.h"
 #include "OptionsParser.h"
+#include "OutputSchema.h"
+#include "OutputWriter.h"
+#include "Prescan.h"
+#include "ReflectFilter.h"
+#include "Reflector.h"
+#include "TUSchedule.h"
+#include "TUSelection.h"
+#include "TemplateRenderer.h"
+#include "Watcher.h"
+#include "WorkerPool.h"
 #include "meta.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/TimeProfiler.h"
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
 
 namespace tooling = clang::tooling;
 // Apply a custom category to all command-line options so that they are the
@@ -32,6 +48,143 @@ static llvm::cl::opt<std::string>
     Root("root", llvm::cl::Required,
          llvm::cl::desc("Specify parse root directory"), ToolCategory,
          llvm::cl::value_desc("directory"));
+static llvm::cl::opt<bool> Watch(
+    "watch",
+    llvm::cl::desc("Keep running after the first parse, regenerate meta files of changed headers under root"),
+    ToolCategory);
+static llvm::cl::opt<unsigned> WatchDebounce(
+    "watch-debounce",
+    llvm::cl::desc("Milliseconds without file events before regeneration starts"),
+    ToolCategory, llvm::cl::init(50));
+static llvm::cl::opt<bool> Prescan(
+    "prescan",
+    llvm::cl::desc("Skip translation units whose includes under root contain no reflection marker"),
+    ToolCategory);
+static llvm::cl::list<std::string> PrescanMarkers(
+    "prescan-marker",
+    llvm::cl::desc("Text that marks a file as reflected for --prescan (default: __reflect__)"),
+    ToolCategory, llvm::cl::value_desc("text"));
+static llvm::cl::opt<bool> SelectCovering(
+    "select-covering",
+    llvm::cl::desc("Parse only a small, cheap set of translation units that includes every header under root, "
+                   "with --prescan only headers containing a marker need to be covered, a translation unit is "
+                   "always parsed for decls of its own source file only if that file contains a marker"),
+    ToolCategory);
+static llvm::cl::list<std::string> CodegenTemplates(
+    "codegen-template",
+    llvm::cl::desc("Render template for each header with reflected decls, <header stem>.X is written for template X.in"),
+    ToolCategory, llvm::cl::value_desc("file"));
+static llvm::cl::opt<std::string> CodegenOutput(
+    "codegen-output",
+    llvm::cl::desc("Directory of files rendered by --codegen-template (default: --output)"),
+    ToolCategory, llvm::cl::value_desc("directory"));
+static llvm::cl::opt<bool> EmitJson(
+    "emit-json",
+    llvm::cl::desc("Write .h.meta json files, can be disabled when --codegen-template is used"),
+    ToolCategory, llvm::cl::init(true));
+static llvm::cl::opt<unsigned> Jobs(
+    "jobs",
+    llvm::cl::desc("Threads used to serialize and write output files (default: all hardware threads)"),
+    ToolCategory, llvm::cl::init(0));
+static llvm::cl::opt<bool> Pipeline(
+    "pipeline",
+    llvm::cl::desc("Write each header as soon as no unfinished translation unit is predicted to include it, "
+                   "predicted by textual include scan, so writing overlaps parsing"),
+    ToolCategory);
+static llvm::cl::opt<unsigned> ParseJobs(
+    "parse-jobs",
+    llvm::cl::desc("Threads parsing translation units with --pipeline (0 uses all hardware threads)"),
+    ToolCategory, llvm::cl::init(1));
+static llvm::cl::opt<unsigned> Workers(
+    "workers",
+    llvm::cl::desc("Parse translation units in this many child processes (0 parses in process), a crash only "
+                   "loses the batch of its worker, which is retried one translation unit at a time"),
+    ToolCategory, llvm::cl::init(0));
+static llvm::cl::opt<std::string> WorkerBatch(
+    "worker-batch",
+    llvm::cl::desc("Translation units parsed by a --workers process, one per line"),
+    ToolCategory, llvm::cl::Hidden, llvm::cl::value_desc("file"));
+static llvm::cl::opt<std::string> WorkerOutput(
+    "worker-output",
+    llvm::cl::desc("Result file of a --workers process, the process parses its batch and exits"),
+    ToolCategory, llvm::cl::Hidden, llvm::cl::value_desc("file"));
+static llvm::cl::opt<unsigned> TUTimeLimit(
+    "tu-time-limit",
+    llvm::cl::desc("Cancel a translation unit after this many milliseconds, with --select-covering "
+                   "its headers are parsed through other translation units"),
+    ToolCategory, llvm::cl::init(0), llvm::cl::value_desc("ms"));
+static llvm::cl::opt<unsigned> TUMemoryLimit(
+    "tu-memory-limit",
+    llvm::cl::desc("Cancel a translation unit once clang allocated this many megabytes for it, "
+                   "with --select-covering its headers are parsed through other translation units"),
+    ToolCategory, llvm::cl::init(0), llvm::cl::value_desc("MB"));
+static llvm::cl::opt<std::string> OutputArchive(
+    "output-archive",
+    llvm::cl::desc("Write all meta files into one archive instead of a file per header, relative path is under --output"),
+    ToolCategory, llvm::cl::value_desc("file"));
+static llvm::cl::opt<bool> ArchiveZstd(
+    "archive-zstd",
+    llvm::cl::desc("Compress each entry of --output-archive with zstd"),
+    ToolCategory);
+static llvm::cl::opt<bool> ReportLayout(
+    "layout-report",
+    llvm::cl::desc("Report padding, better field order and false sharing of reflected records to meta_layout.json"),
+    ToolCategory);
+static llvm::cl::list<std::string> LayoutSharedAttrs(
+    "layout-shared-attr",
+    llvm::cl::desc("Annotation of fields written by different threads, checked for false sharing like atomics"),
+    ToolCategory, llvm::cl::value_desc("text"));
+static llvm::cl::opt<std::string> LayoutCountAttr(
+    "layout-count-attr",
+    llvm::cl::desc("Record annotation <name>=N hints the instance count used to weight padding in --layout-report"),
+    ToolCategory, llvm::cl::init("layout_count"), llvm::cl::value_desc("name"));
+static llvm::cl::opt<bool> FastParseVerify(
+    "fast-parse-verify",
+    llvm::cl::desc("Parse every translation unit with and without --fast-parse, report time saved and output differences"),
+    ToolCategory);
+static llvm::cl::opt<bool> VFSCache(
+    "vfs-cache",
+    llvm::cl::desc("Share stat results and file contents between translation units"),
+    ToolCategory);
+static llvm::cl::list<std::string> VFSCacheDirs(
+    "vfs-cache-dir",
+    llvm::cl::desc("Also keep contents of files under this directory in --vfs-cache (root is always kept)"),
+    ToolCategory, llvm::cl::value_desc("directory"));
+static llvm::cl::opt<bool> VFSCachePersist(
+    "vfs-cache-persist",
+    llvm::cl::desc("Store missing file lookups of --vfs-cache in output directory for next run"),
+    ToolCategory);
+static llvm::cl::opt<std::string> Schema(
+    "schema",
+    llvm::cl::desc("Json file listing the keys written per struct, e.g. {\"Field\": [\"name\", \"type\"]}, "
+                   "data of other keys is not computed"),
+    ToolCategory, llvm::cl::value_desc("file"));
+static llvm::cl::opt<std::string> AttrPrefix(
+    "attr-prefix",
+    llvm::cl::desc("Only annotations starting with this prefix are exported as attrs, "
+                   "the prefix is stripped before they are parsed into attributes"),
+    ToolCategory, llvm::cl::value_desc("text"));
+static llvm::cl::list<std::string> NamespaceIncludes(
+    "namespace-include",
+    llvm::cl::desc("Only reflect decls in namespaces matching this glob (or nested in a matching one)"),
+    ToolCategory, llvm::cl::value_desc("glob"));
+static llvm::cl::list<std::string> NamespaceExcludes(
+    "namespace-exclude",
+    llvm::cl::desc("Skip namespaces matching this glob and everything nested in them"),
+    ToolCategory, llvm::cl::value_desc("glob"));
+static llvm::cl::opt<std::string> MemberAnnotation(
+    "member-annotation",
+    llvm::cl::desc("Only reflect fields, methods and constructors carrying this annotation"),
+    ToolCategory, llvm::cl::value_desc("text"));
+static llvm::cl::opt<std::string> ModulesCachePath(
+    "modules-cache-path",
+    llvm::cl::desc("Parse with clang modules, implicit modules are built into this directory and shared "
+                   "by every translation unit, don't use the cache of the real build"),
+    ToolCategory, llvm::cl::value_desc("directory"));
+static llvm::cl::list<std::string> PrebuiltModulePaths(
+    "prebuilt-module-path",
+    llvm::cl::desc("Directory of prebuilt module files, -fmodule-file flags in the compile database are used as well"),
+    ToolCategory, llvm::cl::value_desc("directory"));
 
 // new command args
 // static llvm::cl::opt<std::string> Config(
@@ -45,24 +198,485 @@ static llvm::cl::opt<std::string>
 
 // custom action
 static meta::FileDataMap data_map;
-class ReflectFrontendAction : public clang::ASTFrontendAction {
-public:
-  ReflectFrontendAction() {}
+static std::unique_ptr<meta::HeaderSchedule> header_schedule; // set while --pipeline parses
+static meta::FileDataMap late_map;                             // decls of headers written by the pipeline before
+static meta::IncludeGraph include_graph;
+static meta::TUCostHistory cost_history; // parse time of earlier runs, orders parallel parsing
+static std::unique_ptr<meta::Reflector> reflector;
+static unsigned suppressed_diagnostics = 0;
+static size_t cancelled_count = 0;
+static std::unique_ptr<meta::ReflectFilter> reflect_filter;
+static std::unique_ptr<meta::OutputSchema> output_schema;
+static std::unique_ptr<meta::FileSystemCache> fs_cache;
+static std::unique_ptr<meta::LayoutReport> layout_report;
+static std::unique_ptr<meta::OutputWriter> output_writer;
+static std::vector<std::pair<std::string, meta::TemplateRenderer>> codegen_templates; // (output suffix, template)
+
+// merge decls of a parse into data_map, headers already handed to output_writer by the pipeline get them in late_map
+static void merge_result(meta::ReflectResult &result) {
+  suppressed_diagnostics += result.suppressed_diagnostics;
+
+  // headers entered before cancel are not covered, covering fixup looks for other translation units
+  for (auto &cancelled : result.cancelled) {
+    llvm::errs() << "[limit] " << cancelled.tu << ": " << cancelled.reason << "\n";
+    include_graph.reset_tu(cancelled.tu);
+    include_graph.add(cancelled.tu, cancelled.tu);
+    ++cancelled_count;
+  }
+  for (auto &[tu, ms] : result.parse_ms) {
+    auto headers = include_graph.headers_of(tu);
+    std::erase(headers, tu);
+    cost_history.record(tu, ms, std::move(headers));
+  }
+  for (auto &[file, db] : result.files) {
+    bool is_released = header_schedule && header_schedule->is_released(file);
+    (is_released ? late_map : data_map)[file].append(std::move(db));
+    if (header_schedule)
+      header_schedule->produce(file);
+  }
+}
+
+// parse translation units and merge their decls into data_map
+static int reflect_sources(llvm::ArrayRef<std::string> SourcePaths) {
+  auto result = reflector->reflect(SourcePaths);
+  merge_result(result);
+  return result.status;
+}
+
+static void write_meta_file(const std::string &OutPath, const std::string &RelPath, meta::Database &db) {
+  // replace extension to .h.meta
+  llvm::SmallString<1024> MetaPath(OutPath + RelPath);
+  llvm::sys::path::replace_extension(MetaPath, ".h.meta");
+
+  // remove stale meta file
+  if (db.is_empty()) {
+    output_writer->remove_file(MetaPath);
+    return;
+  }
+
+  output_writer->write_file(MetaPath, db.serialize(output_schema.get()));
+}
+
+static void write_generated_files(const std::string &RelPath, meta::Database &db) {
+  if (codegen_templates.empty())
+    return;
+
+  // template context, database with file info
+  llvm::json::Value context = nullptr;
+  auto stem = llvm::sys::path::stem(RelPath);
+  if (!db.is_empty()) {
+    context = db.to_json(output_schema.get());
+    context.getAsObject()->try_emplace("file_name", RelPath);
+    context.getAsObject()->try_emplace("stem", stem.str());
+  }
+
+  // <header dir>/<header stem>.<template name without .in>
+  llvm::SmallString<1024> GeneratedDir(CodegenOutput.empty() ? Output : CodegenOutput);
+  GeneratedDir += llvm::sys::path::parent_path(RelPath);
+  for (auto &[suffix, renderer] : codegen_templates) {
+    llvm::SmallString<1024> GeneratedPath(GeneratedDir);
+    llvm::sys::path::append(GeneratedPath, stem + "." + suffix);
+    if (db.is_empty()) {
+      output_writer->remove_file(GeneratedPath);
+    } else {
+      output_writer->write_file(GeneratedPath, renderer.render(context));
+    }
+  }
+}
+
+// serialize and write on output_writer threads, db must stay alive until output_writer->wait()
+static void write_outputs(const std::string &OutPath, const std::string &RelPath, meta::Database &db) {
+  output_writer->async([OutPath, RelPath, &db] {
+    db.canonicalize();
+
+    // meta files go to archive with write_archive
+    if (EmitJson && OutputArchive.empty())
+      write_meta_file(OutPath, RelPath, db);
+    write_generated_files(RelPath, db);
+  });
+}
+
+static bool write_archive(const std::string &OutPath) {
+  if (!EmitJson || OutputArchive.empty())
+    return true;
+
+  // entries are named like meta files relative to output dir, serialized in parallel
+  std::vector<std::pair<std::string, std::string>> entries;
+  std::vector<meta::Database *> dbs;
+  for (auto &[RelPath, db] : data_map) {
+    if (db.is_empty())
+      continue;
+    // keys of data_map start with '/', entry names are relative like the layout under --output
+    llvm::SmallString<1024> EntryName(llvm::StringRef(RelPath).ltrim('/'));
+    llvm::sys::path::replace_extension(EntryName, ".h.meta");
+    entries.emplace_back(EntryName.str().str(), std::string());
+    dbs.push_back(&db);
+  }
+  for (size_t i = 0; i < entries.size(); ++i) {
+    output_writer->async([&entries, &dbs, i] { entries[i].second = dbs[i]->serialize(output_schema.get()); });
+  }
+  output_writer->wait();
+
+  meta::MetaArchiveWriter writer(ArchiveZstd ? meta::ArchiveCompression::Zstd : meta::ArchiveCompression::None);
+  if (ArchiveZstd && writer.compression() != meta::ArchiveCompression::Zstd) {
+    llvm::errs() << "zstd is not available, archive is not compressed\n";
+  }
+  for (auto &[name, content] : entries) {
+    writer.add(name, content);
+  }
+
+  llvm::SmallString<1024> ArchivePath(OutputArchive);
+  if (llvm::sys::path::is_relative(ArchivePath)) {
+    ArchivePath = OutPath;
+    llvm::sys::path::append(ArchivePath, OutputArchive);
+  }
+  llvm::sys::fs::create_directories(llvm::sys::path::parent_path(ArchivePath));
+  if (auto err = writer.write(ArchivePath)) {
+    llvm::errs() << llvm::toString(std::move(err)) << "\n";
+    return false;
+  }
+  return true;
+}
+
+// predicted headers of each translation unit for --pipeline
+static std::unique_ptr<meta::HeaderSchedule> create_header_schedule(const tooling::CompilationDatabase &Compilations,
+                                                                    const std::vector<std::string> &SourcePaths,
+                                                                    meta::Prescanner &prescanner) {
+  std::string RootPath = llvm::sys::path::convert_to_slash(Root);
+  auto schedule = std::make_unique<meta::HeaderSchedule>();
+  for (auto &source : SourcePaths) {
+    auto commands = Compilations.getCompileCommands(source);
+    bool is_complete = !commands.empty();
+    std::vector<std::string> headers;
+    for (auto &command : commands) {
+      auto scan = prescanner.scan_tu(command);
+      is_complete &= scan.is_complete;
+      for (auto &file : scan.files) {
+        if (llvm::StringRef(file).starts_with(RootPath))
+          headers.push_back(file.substr(RootPath.size()));
+      }
+    }
+    schedule->expect(source, std::move(headers), is_complete);
+  }
+  return schedule;
+}
+
+// parse on --parse-jobs threads longest first, headers released by header_schedule are written while parsing goes on
+static int reflect_pipelined(const std::string &OutPath, llvm::ArrayRef<std::string> SourcePaths) {
+  std::mutex mutex; // guards data_map, late_map, header_schedule and cost_history
+  int result = 0;
+  llvm::ThreadPool parse_pool(llvm::hardware_concurrency(ParseJobs));
+  for (auto &source : meta::order_longest_first(SourcePaths, cost_history)) {
+    parse_pool.async([&, source] {
+      auto tu_result = reflector->reflect({source});
+
+      std::lock_guard<std::mutex> lock(mutex);
+      result |= tu_result.status;
+      merge_result(tu_result);
+      for (auto &header : header_schedule->finish(source)) {
+        write_outputs(OutPath, header, data_map[header]);
+      }
+    });
+  }
+  parse_pool.wait();
+  return result;
+}
+
+// parse in --workers child processes, decls of a batch are merged like with reflect_pipelined once its worker exited
+static int reflect_in_workers(const std::string &OutPath, llvm::ArrayRef<std::string> SourcePaths,
+                              llvm::ArrayRef<const char *> args) {
+  meta::WorkerPool pool(llvm::sys::fs::getMainExecutable(args[0], (void *)(intptr_t)&reflect_in_workers),
+                        std::vector<std::string>(args.begin() + 1, args.end()), Workers);
+
+  // several batches per worker keep every worker busy until the end, longest batches start first
+  auto batches = meta::schedule_batches(SourcePaths, cost_history, size_t(Workers) * 4);
+
+  int result = 0;
+  auto failed = pool.run(std::move(batches), [&](llvm::ArrayRef<std::string> batch, const llvm::json::Value &spool) {
+    meta::ReflectResult batch_result;
+    if (!meta::decode_worker_result(spool, batch_result, include_graph))
+      return false;
+
+    result |= batch_result.status;
+    merge_result(batch_result);
+    if (header_schedule) {
+      for (auto &tu : batch) {
+        for (auto &header : header_schedule->finish(tu)) {
+          write_outputs(OutPath, header, data_map[header]);
+        }
+      }
+    }
+    return true;
+  });
+
+  // decls of failed translation units are lost, their headers may still come from other ones
+  for (auto &tu : failed) {
+    result = 1;
+    if (header_schedule) {
+      for (auto &header : header_schedule->finish(tu)) {
+        write_outputs(OutPath, header, data_map[header]);
+      }
+    }
+  }
+  if (!failed.empty()) {
+    llvm::outs() << failed.size() << " translation units failed in --workers processes\n";
+  }
+  return result;
+}
+
+// process of --workers, parses its batch and writes the result for the main process
+static int run_worker(llvm::ArrayRef<std::string> SourcePaths) {
+  auto result = reflector->reflect(SourcePaths);
+  std::error_code ec;
+  llvm::raw_fd_ostream os(WorkerOutput, ec);
+  if (ec) {
+    llvm::errs() << "failed to write worker output: " << WorkerOutput << "\n";
+    llvm::errs() << "error: " << ec.message() << "\n";
+    return 1;
+  }
+  os << meta::encode_worker_result(result, include_graph);
+  return result.status;
+}
+
+// late decls come from includes the textual scan did not predict, or are copies from covering fixup,
+// rewrite a header only if they add a decl, call after output_writer->wait()
+static void write_late_headers(const std::string &OutPath) {
+  size_t rewritten = 0;
+  for (auto &[file, late_db] : late_map) {
+    auto &db = data_map[file];
+    llvm::DenseSet<uint64_t> ids;
+    for (auto &record : db.records)
+      ids.insert(record.id);
+    for (auto &function : db.functions)
+      ids.insert(function.id);
+    for (auto &enum_data : db.enums)
+      ids.insert(enum_data.id);
+    auto is_known = [&](auto &decl) { return decl.id != 0 && ids.contains(decl.id); };
+    if (llvm::all_of(late_db.records, is_known) && llvm::all_of(late_db.functions, is_known) &&
+        llvm::all_of(late_db.enums, is_known))
+      continue;
+
+    db.append(std::move(late_db));
+    write_outputs(OutPath, file, db);
+    ++rewritten;
+  }
+  late_map.clear();
+  if (rewritten) {
+    llvm::outs() << "[pipeline] " << rewritten << " headers rewritten, they are included by translation units "
+                 << "the include scan did not predict\n";
+  }
+}
+
+static int watch_loop(const std::string &OutPath) {
+  std::string RootPath = llvm::sys::path::convert_to_slash(Root);
+  meta::Watcher watcher(RootPath);
+  if (auto err = watcher.start()) {
+    llvm::errs() << "failed to start watch: " << llvm::toString(std::move(err)) << "\n";
+    return 1;
+  }
+
+  llvm::outs() << "===========start watch===========\n";
+  while (true) {
+    auto changes = watcher.wait_changes(std::chrono::milliseconds(WatchDebounce));
+    auto start = std::chrono::steady_clock::now();
+
+    // collect translation units that include changed files
+    std::vector<std::string> dirty_tus;
+    for (auto &file : changes) {
+      for (auto &tu : include_graph.tus_of(file)) {
+        if (std::find(dirty_tus.begin(), dirty_tus.end(), tu) == dirty_tus.end())
+          dirty_tus.push_back(tu);
+      }
+    }
+    if (dirty_tus.empty())
+      continue;
+
+    // drop data produced by these translation units
+    llvm::StringSet<> dirty_headers;
+    for (auto &tu : dirty_tus) {
+      for (auto &header : include_graph.headers_of(tu)) {
+        dirty_headers.insert(header);
+      }
+      include_graph.reset_tu(tu);
+    }
+    for (auto &header : dirty_headers) {
+      if (header.getKey().starts_with(RootPath))
+        data_map.erase(header.getKey().substr(RootPath.size()).str());
+    }
+
+    // reparse
+    if (fs_cache) {
+      for (auto &file : changes) {
+        fs_cache->invalidate(file);
+      }
+    }
+    reflect_sources(dirty_tus);
+
+    // headers may be newly included by the reparsed translation units
+    for (auto &tu : dirty_tus) {
+      for (auto &header : include_graph.headers_of(tu)) {
+        dirty_headers.insert(header);
+      }
+    }
+
+    // rewrite affected meta files
+    for (auto &header : dirty_headers) {
+      if (!header.getKey().starts_with(RootPath))
+        continue;
+      auto rel_path = header.getKey().substr(RootPath.size()).str();
+      write_outputs(OutPath, rel_path, data_map[rel_path]);
+    }
+    if (!output_writer->wait() || !write_archive(OutPath))
+      return 1;
+
+    auto end = std::chrono::steady_clock::now();
+    llvm::outs() << "[watch] " << dirty_tus.size() << " translation units, "
+                 << dirty_headers.size() << " headers regenerated in "
+                 << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+                 << "ms\n";
+  }
+  return 0;
+}
+
+static bool is_same_output(meta::FileDataMap &a, meta::FileDataMap &b) {
+  auto contains_all = [](meta::FileDataMap &from, meta::FileDataMap &to) {
+    for (auto &[file, db] : from) {
+      if (db.is_empty())
+        continue;
+      db.canonicalize();
+      auto found = to.find(file);
+      if (found != to.end())
+        found->second.canonicalize();
+      if (found == to.end() || found->second.serialize() != db.serialize())
+        return false;
+    }
+    return true;
+  };
+  return contains_all(a, b) && contains_all(b, a);
+}
+
+static int run_fast_parse_verify(const std::vector<std::string> &SourcePaths) {
+  int result = 0;
+  size_t diff_count = 0;
+  std::chrono::milliseconds total_full{0}, total_fast{0};
+  for (auto &source : SourcePaths) {
+    // full command line, diagnostics are printed by the fast run
+    auto start = std::chrono::steady_clock::now();
+    auto full_map = reflector->reflect({source}, false, true).files;
+
+    // fast profile
+    auto mid = std::chrono::steady_clock::now();
+    auto fast_result = reflector->reflect({source});
+    result |= fast_result.status;
+    auto &fast_map = fast_result.files;
+    auto end = std::chrono::steady_clock::now();
+
+    auto full_time = std::chrono::duration_cast<std::chrono::milliseconds>(mid - start);
+    auto fast_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - mid);
+    total_full += full_time;
+    total_fast += fast_time;
+    bool identical = is_same_output(full_map, fast_map);
+    diff_count += identical ? 0 : 1;
+    llvm::outs() << "[fast-parse] " << source << ": full " << full_time.count()
+                 << "ms, fast " << fast_time.count() << "ms, saved "
+                 << (full_time - fast_time).count() << "ms, output "
+                 << (identical ? "identical" : "differs") << "\n";
+
+    merge_result(fast_result);
+  }
+  llvm::outs() << "[fast-parse] total: full " << total_full.count() << "ms, fast "
+               << total_fast.count() << "ms, saved " << (total_full - total_fast).count()
+               << "ms, " << diff_count << " translation units with different output\n";
+  return result;
+}
+
+// candidates of --select-covering, cost is the size of the whole textual include closure
+static std::vector<meta::TUCoverage> scan_coverage(const tooling::CompilationDatabase &Compilations,
+                                                   const std::vector<std::string> &SourcePaths,
+                                                   meta::Prescanner &prescanner) {
+  std::string RootPath = llvm::sys::path::convert_to_slash(Root);
+  std::vector<meta::TUCoverage> candidates;
+  for (auto &source : SourcePaths) {
+    meta::TUCoverage candidate;
+    candidate.tu = source;
+    auto commands = Compilations.getCompileCommands(source);
+    candidate.must_select = commands.empty();
 
-  std::unique_ptr<clang::ASTConsumer>
-  CreateASTConsumer(clang::CompilerInstance &compiler, llvm::StringRef file) {
-    // fronted opts
-    auto &FO = compiler.getFrontendOpts();
-    FO.SkipFunctionBodies = true;
-    FO.ProgramAction = clang::frontend::ParseSyntaxOnly;
+    llvm::StringSet<> headers;
+    for (auto &command : commands) {
+      llvm::SmallString<1024> main_file(command.Filename);
+      llvm::sys::fs::make_absolute(command.Directory, main_file);
+      auto main_path = meta::normalize_path(main_file);
 
-    // lang opts
-    auto &LO = compiler.getLangOpts();
-    LO.CommentOpts.ParseAllComments = true;
+      auto scan = prescanner.scan_tu(command, true);
+      candidate.cost += scan.bytes;
+      candidate.must_select |= !scan.is_complete;
+      for (auto &file : scan.files) {
+        if (!llvm::StringRef(file).starts_with(RootPath))
+          continue;
+        auto file_scan = prescanner.scan_file(file);
+        bool has_marker = file_scan && file_scan->has_marker;
 
-    return std::make_unique<meta::ASTConsumer>(data_map, Root);
+        // a source file can only be covered by itself, it is forced only for a marker even without --prescan,
+        // otherwise every translation unit under root is selected and nothing is saved
+        if (file == main_path) {
+          candidate.must_select |= has_marker;
+        } else if ((!Prescan || has_marker) && headers.insert(file).second) {
+          candidate.headers.push_back(file);
+        }
+      }
+    }
+    candidates.push_back(std::move(candidate));
   }
-};
+  return candidates;
+}
+
+// textual scan cannot see through macros and #if, parse more translation units
+// until every expected header is really included by a parsed one
+static int run_covering_fixup(const std::vector<meta::TUCoverage> &candidates,
+                              std::vector<bool> &selected) {
+  int result = 0;
+  while (true) {
+    llvm::StringSet<> covered;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      if (!selected[i])
+        continue;
+      for (auto &header : include_graph.headers_of(meta::normalize_path(candidates[i].tu))) {
+        covered.insert(header);
+      }
+    }
+
+    // unselected translation units restricted to missing headers
+    std::vector<meta::TUCoverage> retry;
+    std::vector<size_t> retry_index;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+      if (selected[i])
+        continue;
+      meta::TUCoverage candidate;
+      candidate.tu = candidates[i].tu;
+      candidate.cost = candidates[i].cost;
+      for (auto &header : candidates[i].headers) {
+        if (!covered.count(header))
+          candidate.headers.push_back(header);
+      }
+      if (!candidate.headers.empty()) {
+        retry.push_back(std::move(candidate));
+        retry_index.push_back(i);
+      }
+    }
+    if (retry.empty())
+      break;
+
+    std::vector<std::string> sources;
+    for (auto index : meta::select_covering_tus(retry)) {
+      selected[retry_index[index]] = true;
+      sources.push_back(retry[index].tu);
+    }
+    llvm::outs() << "[select] parse " << sources.size() << " more translation units for headers not included as predicted\n";
+    result |= reflect_sources(sources);
+  }
+  return result;
+}
 
 int main(int argc, const char **argv) {
   // copy args
@@ -71,8 +685,6 @@ int main(int argc, const char **argv) {
     args.push_back(argv[i]);
   }
 
-  // meta def
-  args.insert(args.begin() + 1, "--extra-arg=-D__meta__");
   argc = args.size();
 
   // parse args
@@ -93,11 +705,251 @@ int main(int argc, const char **argv) {
   // init time trace
   timeTraceProfilerInitialize(32, llvm::StringRef{args[0]});
 
-  // run tool
-  // auto start = std::chrono::high_resolution_clock::now();
-  tooling::ClangTool Tool(OptionsParser.getCompilations(), OptionsParser.getSourcePathList());
+  // load codegen templates
+  for (auto &path : CodegenTemplates) {
+    auto renderer = meta::TemplateRenderer::create(path);
+    if (!renderer) {
+      llvm::errs() << llvm::toString(renderer.takeError()) << "\n";
+      return 1;
+    }
+    auto suffix = llvm::sys::path::filename(path);
+    if (suffix.ends_with(".in"))
+      suffix = suffix.drop_back(3);
+    codegen_templates.emplace_back(suffix.str(), std::move(*renderer));
+  }
+
+  // output schema
+  if (!Schema.empty()) {
+    auto schema = meta::OutputSchema::load(Schema);
+    if (!schema) {
+      llvm::errs() << llvm::toString(schema.takeError()) << "\n";
+      return 1;
+    }
+    output_schema = std::make_unique<meta::OutputSchema>(std::move(*schema));
+  }
+
+  // a --workers process gets the command line of the main process, it only parses its batch
+  std::vector<std::string> SourcePaths = OptionsParser.getSourcePathList();
+  bool is_worker = !WorkerOutput.empty();
+  if (is_worker) {
+    Prescan = false;
+    SelectCovering = false;
+    Pipeline = false;
+    Watch = false;
+    FastParseVerify = false;
+    ReportLayout = false;
+    VFSCachePersist = false;
+
+    auto batch = llvm::MemoryBuffer::getFile(WorkerBatch);
+    if (!batch) {
+      llvm::errs() << "failed to read worker batch: " << WorkerBatch << "\n";
+      return 1;
+    }
+    llvm::SmallVector<llvm::StringRef, 16> lines;
+    (*batch)->getBuffer().split(lines, '\n', -1, false);
+    SourcePaths.assign(lines.begin(), lines.end());
+  }
+
+  // textual scanner shared by prescan and covering selection
+  auto &Compilations = OptionsParser.getCompilations();
+  std::unique_ptr<meta::Prescanner> prescanner;
+  llvm::SmallString<1024> prescan_cache_path(Output);
+  llvm::sys::path::append(prescan_cache_path, "meta_prescan.json");
+  if (Prescan || SelectCovering || Pipeline) {
+    std::vector<std::string> markers(PrescanMarkers.begin(), PrescanMarkers.end());
+    if (markers.empty()) {
+      markers.push_back("__reflect__");
+    }
+    prescanner = std::make_unique<meta::Prescanner>(llvm::sys::path::convert_to_slash(Root), std::move(markers));
+    prescanner->load_cache(prescan_cache_path);
+  }
+
+  // prescan
+  if (Prescan) {
+    llvm::outs() << "===========start prescan===========\n";
+
+    // filter translation units
+    size_t source_count = SourcePaths.size();
+    auto newEnd = std::remove_if(
+        SourcePaths.begin(), SourcePaths.end(), [&](const std::string &path) {
+          auto commands = Compilations.getCompileCommands(path);
+          if (commands.empty())
+            return false;
+          for (auto &command : commands) {
+            if (prescanner->scan_tu(command).may_reflect())
+              return false;
+          }
+
+          // watch mode, parse it once a header it includes changed
+          if (Watch) {
+            for (auto &command : commands) {
+              llvm::SmallString<1024> tu(command.Filename);
+              llvm::sys::fs::make_absolute(command.Directory, tu);
+              auto tu_path = meta::normalize_path(tu);
+              include_graph.add(tu_path, tu_path);
+              for (auto &file : prescanner->scan_tu(command).files) {
+                include_graph.add(tu_path, file);
+              }
+            }
+          }
+          return true;
+        });
+    SourcePaths.erase(newEnd, SourcePaths.end());
+    llvm::outs() << "skipped " << source_count - SourcePaths.size() << " of " << source_count
+                 << " translation units, scanned " << prescanner->scanned_files()
+                 << " files, " << prescanner->cached_files() << " files from cache\n";
+    llvm::outs() << "===========end prescan===========\n";
+  }
+
+  // covering selection
+  std::vector<meta::TUCoverage> candidates;
+  std::vector<bool> selected;
+  if (SelectCovering) {
+    llvm::outs() << "===========start select===========\n";
+    candidates = scan_coverage(Compilations, SourcePaths, *prescanner);
+    selected.assign(candidates.size(), false);
+    SourcePaths.clear();
+    for (auto index : meta::select_covering_tus(candidates)) {
+      selected[index] = true;
+      SourcePaths.push_back(candidates[index].tu);
+    }
+
+    // watch mode, parse it once itself changed
+    if (Watch) {
+      for (size_t i = 0; i < candidates.size(); ++i) {
+        if (selected[i])
+          continue;
+        auto tu_path = meta::normalize_path(candidates[i].tu);
+        include_graph.add(tu_path, tu_path);
+      }
+    }
+    llvm::outs() << "selected " << SourcePaths.size() << " of " << candidates.size()
+                 << " translation units\n";
+    llvm::outs() << "===========end select===========\n";
+  }
+
+  // pipeline, verify mode parses everything twice and writes at the end
+  if (Pipeline && !FastParseVerify) {
+    header_schedule = create_header_schedule(Compilations, SourcePaths, *prescanner);
+  }
+
+  // save scan cache
+  if (prescanner && !llvm::sys::fs::create_directories(Output)) {
+    if (auto err = prescanner->save_cache(prescan_cache_path)) {
+      llvm::errs() << "failed to write prescan cache: " << llvm::toString(std::move(err)) << "\n";
+    }
+  }
+
+  // parse time of earlier runs
+  llvm::SmallString<1024> tu_cost_path(Output);
+  llvm::sys::path::append(tu_cost_path, "meta_tu_cost.json");
+  if (!is_worker) {
+    cost_history.load(tu_cost_path);
+  }
+
+  // file system cache
+  llvm::SmallString<1024> vfs_cache_path(Output);
+  llvm::sys::path::append(vfs_cache_path, "meta_vfs_cache.json");
+  if (VFSCache) {
+    std::vector<std::string> content_dirs{llvm::sys::path::convert_to_slash(Root)};
+    for (auto &dir : VFSCacheDirs) {
+      content_dirs.push_back(meta::normalize_path(dir));
+    }
+    fs_cache = std::make_unique<meta::FileSystemCache>(std::move(content_dirs));
+    if (VFSCachePersist) {
+      fs_cache->load(vfs_cache_path);
+    }
+  }
+
+  // layout report
+  if (ReportLayout) {
+    layout_report = std::make_unique<meta::LayoutReport>(
+        std::vector<std::string>(LayoutSharedAttrs.begin(), LayoutSharedAttrs.end()), LayoutCountAttr);
+  }
+
+  // decl filter
+  {
+    auto filter = meta::ReflectFilter::create(
+        AttrPrefix,
+        std::vector<std::string>(NamespaceIncludes.begin(), NamespaceIncludes.end()),
+        std::vector<std::string>(NamespaceExcludes.begin(), NamespaceExcludes.end()),
+        MemberAnnotation);
+    if (!filter) {
+      llvm::errs() << llvm::toString(filter.takeError()) << "\n";
+      return 1;
+    }
+    reflect_filter = std::make_unique<meta::ReflectFilter>(std::move(*filter));
+  }
+
+  // parser
+  meta::ReflectorOptions reflector_options;
+  reflector_options.root = Root;
+  reflector_options.fast_parse_adjuster = OptionsParser.getFastParseAdjuster();
+  if (FastParseVerify && !reflector_options.fast_parse_adjuster) {
+    reflector_options.fast_parse_adjuster = meta::getFastParseArgumentsAdjuster();
+  }
+  if (Watch || SelectCovering || is_worker) {
+    reflector_options.include_graph = &include_graph;
+  }
+  if (!ModulesCachePath.empty()) {
+    reflector_options.modules_cache_path = meta::normalize_path(ModulesCachePath);
+  }
+  for (auto &path : PrebuiltModulePaths) {
+    reflector_options.prebuilt_module_paths.push_back(meta::normalize_path(path));
+  }
+  reflector_options.filter = reflect_filter.get();
+  reflector_options.schema = output_schema.get();
+  reflector_options.fs_cache = fs_cache.get();
+  reflector_options.layout_report = layout_report.get();
+  reflector_options.time_limit_ms = TUTimeLimit;
+  reflector_options.memory_limit_bytes = uint64_t(TUMemoryLimit) << 20;
+  reflector = std::make_unique<meta::Reflector>(Compilations, std::move(reflector_options));
+
+  if (is_worker) {
+    return run_worker(SourcePaths);
+  }
+
+  // output, the pipeline writes while parsing
+  std::string OutPath;
+  OutPath = Output;
+  output_writer = std::make_unique<meta::OutputWriter>(Jobs);
+
   llvm::outs() << "===========start compile===========\n";
-  int result = Tool.run(tooling::newFrontendActionFactory<ReflectFrontendAction>().get());
+  int result = 0;
+  if (Workers && (FastParseVerify || layout_report)) {
+    llvm::outs() << "--fast-parse-verify and --layout-report parse in process, --workers is ignored\n";
+  }
+  if (FastParseVerify) {
+    result = run_fast_parse_verify(SourcePaths);
+  } else if (Workers && !layout_report) {
+    result = reflect_in_workers(OutPath, SourcePaths, args);
+  } else if (header_schedule) {
+    result = reflect_pipelined(OutPath, SourcePaths);
+  } else {
+    result = reflect_sources(SourcePaths);
+  }
+  if (SelectCovering) {
+    result |= run_covering_fixup(candidates, selected);
+  }
+  if (suppressed_diagnostics) {
+    llvm::outs() << suppressed_diagnostics << " diagnostics outside root are hidden\n";
+  }
+  if (cancelled_count) {
+    llvm::outs() << cancelled_count << " translation units cancelled by --tu-time-limit or --tu-memory-limit\n";
+  }
+  if (!llvm::sys::fs::create_directories(Output)) {
+    if (auto err = cost_history.save(tu_cost_path)) {
+      llvm::errs() << "failed to write translation unit costs: " << llvm::toString(std::move(err)) << "\n";
+    }
+  }
+  if (fs_cache) {
+    llvm::outs() << "vfs cache: " << fs_cache->hit_count() << " hits, " << fs_cache->miss_count() << " misses\n";
+    if (VFSCachePersist && !llvm::sys::fs::create_directories(Output)) {
+      if (auto err = fs_cache->save(vfs_cache_path)) {
+        llvm::errs() << "failed to write vfs cache: " << llvm::toString(std::move(err)) << "\n";
+      }
+    }
+  }
   llvm::outs() << "===========end compile===========\n";
   // auto end = std::chrono::high_resolution_clock::now();
   // std::cout << "[" << Root << "]\n"
@@ -106,32 +958,40 @@ int main(int argc, const char **argv) {
   //           << "ms\n";
 
   // serialize
-  std::string OutPath;
-  OutPath = Output;
   llvm::outs() << "===========start write===========\n";
-  for (auto &pair : data_map) {
-    if (pair.second.is_empty())
-      continue;
+  if (header_schedule) {
+    for (auto &header : header_schedule->release_remaining()) {
+      write_outputs(OutPath, header, data_map[header]);
+    }
+    if (!output_writer->wait())
+      return 1;
+    write_late_headers(OutPath);
+    header_schedule.reset();
+  } else {
+    for (auto &pair : data_map) {
+      if (pair.second.is_empty())
+        continue;
 
-    // replace extension to .h.meta
-    llvm::SmallString<1024> MetaPath(OutPath + pair.first);
-    llvm::sys::path::replace_extension(MetaPath, ".h.meta");
+      write_outputs(OutPath, pair.first, pair.second);
+    }
+  }
+  if (!output_writer->wait() || !write_archive(OutPath))
+    return 1;
+  llvm::outs() << "===========end write===========\n";
 
-    // create meta dir
-    llvm::SmallString<1024> MetaDir = MetaPath;
-    llvm::sys::path::remove_filename(MetaDir);
-    auto error_code = llvm::sys::fs::create_directories(MetaDir);
-    if (error_code) {
-      llvm::errs() << "failed to create directory: " << MetaDir << "\n";
-      llvm::errs() << "error: " << error_code.message() << "\n";
+  // layout report
+  if (layout_report) {
+    llvm::outs() << "===========start layout report===========\n";
+    llvm::SmallString<1024> layout_path(OutPath);
+    llvm::sys::path::append(layout_path, "meta_layout.json");
+    llvm::sys::fs::create_directories(OutPath);
+    if (auto err = layout_report->write_json(layout_path)) {
+      llvm::errs() << "failed to write layout report: " << llvm::toString(std::move(err)) << "\n";
       return 1;
     }
-
-    // write meta file
-    std::ofstream of(MetaPath.str().str());
-    of << pair.second.serialize();
+    layout_report->print_summary(llvm::outs());
+    llvm::outs() << "===========end layout report===========\n";
   }
-  llvm::outs() << "===========end write===========\n";
 
   // output time trace
   llvm::outs() << "===========start dump trace===========\n";
@@ -163,5 +1023,10 @@ int main(int argc, const char **argv) {
   }
   llvm::outs() << "===========end dump trace===========\n";
 
+  // incremental regeneration
+  if (Watch) {
+    return watch_loop(OutPath);
+  }
+
   return result;
 }
\ No newline at end of file
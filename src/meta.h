@@ -5,9 +5,12 @@
 #include "clang/AST/Attr.h"
 #include "clang/AST/DeclCXX.h"
 #include "clang/AST/PrettyPrinter.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/JSON.h"
 #include <algorithm>
+#include <map>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 
 // forward
@@ -28,35 +31,102 @@ META_SERDE_FWD(Database);
 } // namespace meta
 
 namespace meta {
+// minimal perfect hash of names, see hash.h for lookup
+struct PerfectHash {
+  uint64_t seed = 0;
+  std::vector<int64_t> displacements; // empty if not built
+  std::vector<uint32_t> slots;        // slot -> index of name
+};
+META_SERDE_FUNCTION(PerfectHash) {
+  serde_obj(s, key, [&] {
+    META_SERDE(seed)
+    META_SERDE(displacements)
+    META_SERDE(slots)
+  });
+}
+
+// rows [begin, begin + count) of a flat table in Database
+struct Range {
+  uint32_t begin = 0;
+  uint32_t count = 0;
+};
+
+// stream wrapper that also carries the database being written or read, ranges are resolved against its tables
+template <typename Inner>
+class DatabaseStream : public SchemaStream<Inner> {
+public:
+  DatabaseStream(Inner &inner, const OutputSchema *schema, Database &database)
+      : SchemaStream<Inner>(inner, schema), _database(database) {}
+
+  Database &database() const { return _database; }
+
+private:
+  Database &_database;
+};
+
+template <typename T>
+void move_append(std::vector<T> &to, std::vector<T> &from) {
+  to.insert(to.end(), std::make_move_iterator(from.begin()), std::make_move_iterator(from.end()));
+}
+
+// rows of a table are written as nested array, so the output keeps the nested layout,
+// reading adds the rows to the end of the table after the rows nested in them
+template <typename Stream, typename T>
+void serde_rows(Stream &s, std::string_view key, std::vector<T> &table, Range &range) {
+  if constexpr (serde_is_reader<Stream>()) {
+    std::vector<T> rows(s.array_size(key));
+    s.attributeArray(key, [&] {
+      for (auto &row : rows) {
+        serde(s, "", row);
+      }
+    });
+    range = {uint32_t(table.size()), uint32_t(rows.size())};
+    move_append(table, rows);
+  } else {
+    s.attributeArray(key, [&] {
+      for (uint32_t i = range.begin; i < range.begin + range.count; ++i) {
+        serde(s, "", table[i]);
+      }
+    });
+  }
+}
+#define META_SERDE_ROWS(__F, __Table)                           \
+  if (serde_has_key<std::remove_cvref_t<decltype(v)>>(s, #__F)) \
+    serde_rows(s, #__F, s.database().__Table, v.__F);
+
 struct Constructor {
   std::string name;
   std::string access = "none";
 
-  std::vector<struct Field> parameters;
+  Range parameters; // in Database::params
 
   std::string comment;
   std::string file_name;
   int line;
 
-  std::vector<std::string> attrs;
+  std::vector<std::string> attrs;  // annotation text as written
+  llvm::json::Object attributes; // annotations parsed and merged, see AttrParser.h
 };
 META_SERDE_FUNCTION(Constructor) {
   serde_obj(s, key, [&] {
     META_SERDE(name)
     META_SERDE(access)
 
-    META_SERDE(parameters)
+    META_SERDE_ROWS(parameters, params)
 
     META_SERDE(comment)
     META_SERDE(file_name)
     META_SERDE(line)
 
     META_SERDE(attrs)
+    META_SERDE(attributes)
   });
 }
 
 struct Function {
   std::string name;
+  std::string usr; // clang unified symbol resolution, empty for function pointer signature
+  uint64_t id = 0; // xxh3 64 of usr
   std::string access = "none";
 
   bool is_static;
@@ -65,17 +135,20 @@ struct Function {
 
   std::string ret_type;
   std::string raw_ret_type;
-  std::vector<struct Field> parameters;
+  Range parameters; // in Database::params
 
   std::string comment;
   std::string file_name;
   int line;
 
   std::vector<std::string> attrs;
+  llvm::json::Object attributes;
 };
 META_SERDE_FUNCTION(Function) {
   serde_obj(s, key, [&] {
     META_SERDE(name)
+    META_SERDE(usr)
+    META_SERDE(id)
     META_SERDE(access)
 
     META_SERDE(is_static)
@@ -84,13 +157,14 @@ META_SERDE_FUNCTION(Function) {
 
     META_SERDE(ret_type)
     META_SERDE(raw_ret_type)
-    META_SERDE(parameters)
+    META_SERDE_ROWS(parameters, params)
 
     META_SERDE(comment)
     META_SERDE(file_name)
     META_SERDE(line)
 
     META_SERDE(attrs)
+    META_SERDE(attributes)
   });
 };
 
@@ -99,6 +173,8 @@ struct Field {
   std::string access = "none";
   std::string type;
   std::string raw_type;
+  uint64_t type_id = 0; // id of raw_type, equals id of the record or enum it refers to
+  uint64_t type_hash = 0; // see hash.h, equals type_hash of the record or enum it refers to
 
   size_t array_size = 0;
   std::string default_value;
@@ -106,12 +182,13 @@ struct Field {
   bool is_callback = false;
   bool is_anonymous = false;
   bool is_static = false;
-  Function signature;
+  int32_t signature = -1; // in Database::signatures, set for callback
 
   std::string comment;
   int line;
 
   std::vector<std::string> attrs;
+  llvm::json::Object attributes;
 };
 META_SERDE_FUNCTION(Field) {
   serde_obj(s, key, [&] {
@@ -119,6 +196,8 @@ META_SERDE_FUNCTION(Field) {
     META_SERDE(access)
     META_SERDE(type)
     META_SERDE(raw_type)
+    META_SERDE(type_id)
+    META_SERDE(type_hash)
 
     META_SERDE(array_size)
     META_SERDE(default_value)
@@ -128,118 +207,339 @@ META_SERDE_FUNCTION(Field) {
     META_SERDE(is_anonymous)
     META_SERDE(is_static)
 
-    if (v.is_callback) {
-      META_SERDE_N(signature, "functor")
+    if (v.is_callback && serde_has_key<Field>(s, "functor")) {
+      auto &signatures = s.database().signatures;
+      if constexpr (serde_is_reader<Stream>()) {
+        Function signature;
+        serde(s, "functor", signature);
+        v.signature = signatures.size();
+        signatures.push_back(std::move(signature));
+      } else {
+        serde(s, "functor", signatures[v.signature]);
+      }
     }
 
     META_SERDE(comment)
     META_SERDE(line)
 
     META_SERDE(attrs)
+    META_SERDE(attributes)
   });
 }
 
 struct Record {
   std::string name;
+  std::string usr;
+  uint64_t id = 0;
+  uint64_t type_hash = 0;
+  // xxh3 over size, alignment, bases and fields in order with canonical types, offsets and annotations, and the
+  // annotations of the record, not over its name, comments or lines; a field of record type only adds its type name
+  uint64_t structural_hash = 0;
 
   bool is_nested;
   std::vector<std::string> bases;
-  std::vector<Field> fields;
-  std::vector<Function> methods;
-  std::vector<Constructor> ctors;
+  std::vector<uint64_t> base_ids;
+  std::vector<uint64_t> base_hashes;
+  Range fields;  // in Database::fields
+  Range methods; // in Database::methods
+  Range ctors;   // in Database::ctors
+  PerfectHash field_hash; // over names of fields in order
 
   std::string file_name;
   std::string comment;
   int line;
 
   std::vector<std::string> attrs;
+  llvm::json::Object attributes;
 };
 META_SERDE_FUNCTION(Record) {
   serde_obj(s, key, [&] {
     META_SERDE(name)
+    META_SERDE(usr)
+    META_SERDE(id)
+    META_SERDE(type_hash)
+    META_SERDE(structural_hash)
 
     META_SERDE(is_nested)
     META_SERDE(bases)
-    META_SERDE(fields)
-    META_SERDE(methods)
-    META_SERDE(ctors)
+    META_SERDE(base_ids)
+    META_SERDE(base_hashes)
+    META_SERDE_ROWS(fields, fields)
+    META_SERDE_ROWS(methods, methods)
+    META_SERDE_ROWS(ctors, ctors)
+    META_SERDE(field_hash)
 
     META_SERDE(file_name)
     META_SERDE(comment)
     META_SERDE(line)
 
     META_SERDE(attrs)
+    META_SERDE(attributes)
   });
 }
 
+// enum integer keeps its bit pattern in int64_t, written as unsigned for unsigned underlying type
+template <typename Stream>
+void serde_enum_integer(Stream &s, std::string_view key, int64_t &v, bool is_signed) {
+  if (is_signed || serde_is_reader<Stream>()) {
+    serde(s, key, v);
+  } else {
+    uint64_t unsigned_v = v;
+    serde(s, key, unsigned_v);
+  }
+}
+
 struct EnumValue {
   std::string name;
 
-  uint64_t value;
+  int64_t value;
+  bool is_signed = false; // same as Enum::is_signed, not serialized
 
   std::string comment;
   int line;
 
   std::vector<std::string> attrs;
+  llvm::json::Object attributes;
 };
 META_SERDE_FUNCTION(EnumValue) {
   serde_obj(s, key, [&] {
     META_SERDE(name)
 
-    META_SERDE(value)
+    if (serde_has_key<EnumValue>(s, "value"))
+      serde_enum_integer(s, "value", v.value, v.is_signed);
 
     META_SERDE(comment)
     META_SERDE(line)
 
     META_SERDE(attrs)
+    META_SERDE(attributes)
   });
 }
 
 struct Enum {
   std::string name;
-
-  std::string underlying_type;
+  std::string usr;
+  uint64_t id = 0;
+  uint64_t type_hash = 0;
+  // xxh3 over underlying type, scoped, values in order with annotations, and the annotations of the enum
+  uint64_t structural_hash = 0;
+
+  std::string underlying_type; // for unfixed enum, the type chosen by compiler
+  bool is_fixed = false;
+  bool is_signed = false;
+  unsigned bit_width = 0;
   bool is_scoped;
   std::vector<EnumValue> values;
 
+  // value set shape
+  int64_t min_value = 0;
+  int64_t max_value = 0;
+  bool is_contiguous = false; // distinct values are exactly [min_value, max_value]
+  bool is_flags = false;      // non-negative, every value is zero or an or of single bit values, at least two bits
+  PerfectHash value_hash;     // over values[i].name without enum qualifier
+
   std::string file_name;
   std::string comment;
   int line;
 
   std::vector<std::string> attrs;
+  llvm::json::Object attributes;
 };
 META_SERDE_FUNCTION(Enum) {
   serde_obj(s, key, [&] {
     META_SERDE(name)
+    META_SERDE(usr)
+    META_SERDE(id)
+    META_SERDE(type_hash)
+    META_SERDE(structural_hash)
 
     META_SERDE(underlying_type)
+    META_SERDE(is_fixed)
+    META_SERDE(is_signed)
+    META_SERDE(bit_width)
     META_SERDE(is_scoped)
     META_SERDE(values)
 
+    if (serde_has_key<Enum>(s, "min_value"))
+      serde_enum_integer(s, "min_value", v.min_value, v.is_signed);
+    if (serde_has_key<Enum>(s, "max_value"))
+      serde_enum_integer(s, "max_value", v.max_value, v.is_signed);
+    if constexpr (serde_is_reader<Stream>()) {
+      for (auto &value : v.values) {
+        value.is_signed = v.is_signed;
+      }
+    }
+    META_SERDE(is_contiguous)
+    META_SERDE(is_flags)
+    META_SERDE(value_hash)
+
     META_SERDE(file_name)
     META_SERDE(comment)
     META_SERDE(line)
 
     META_SERDE(attrs)
+    META_SERDE(attributes)
   });
 };
 
+// decls of one file ordered by line & name, same id (or same name & line without id) is one decl
+template <typename T>
+void canonicalize_decls(std::vector<T> &decls) {
+  std::stable_sort(decls.begin(), decls.end(), [](const T &a, const T &b) {
+    return std::tie(a.line, a.name, a.id) < std::tie(b.line, b.name, b.id);
+  });
+  auto new_end = std::unique(decls.begin(), decls.end(), [](const T &a, const T &b) {
+    if (a.id != 0 || b.id != 0)
+      return a.id == b.id;
+    return a.name == b.name && a.line == b.line;
+  });
+  decls.erase(new_end, decls.end());
+}
+
 struct Database {
   std::vector<Record> records;
   std::vector<Function> functions;
   std::vector<Enum> enums;
+
+  // flat tables, records and functions refer to their rows by Range, callback fields to signatures by index,
+  // rows of one range are contiguous and nested rows (parameters of a callback parameter) are added before them
+  std::vector<Field> fields;
+  std::vector<Function> methods;
+  std::vector<Constructor> ctors;
+  std::vector<Field> params;
+  std::vector<Function> signatures;
+
+  // rows of a decl
+  llvm::ArrayRef<Field> fields_of(const Record &record) const { return _rows(fields, record.fields); }
+  llvm::ArrayRef<Function> methods_of(const Record &record) const { return _rows(methods, record.methods); }
+  llvm::ArrayRef<Constructor> ctors_of(const Record &record) const { return _rows(ctors, record.ctors); }
+  llvm::ArrayRef<Field> parameters_of(const Function &function) const { return _rows(params, function.parameters); }
+  llvm::ArrayRef<Field> parameters_of(const Constructor &ctor) const { return _rows(params, ctor.parameters); }
+  const Function *signature_of(const Field &field) const {
+    return field.signature < 0 ? nullptr : &signatures[field.signature];
+  }
+
+  // move rows to the end of a table
+  template <typename T>
+  static Range add_rows(std::vector<T> &table, std::vector<T> &&rows) {
+    Range range = {uint32_t(table.size()), uint32_t(rows.size())};
+    move_append(table, rows);
+    return range;
+  }
+
   inline bool is_empty() {
     return records.empty() && functions.empty() && enums.empty();
   }
-  inline std::string serialize() const {
+  inline void append(Database &&other) {
+    other._rebase(fields.size(), methods.size(), ctors.size(), params.size(), signatures.size());
+    move_append(records, other.records);
+    move_append(functions, other.functions);
+    move_append(enums, other.enums);
+    move_append(fields, other.fields);
+    move_append(methods, other.methods);
+    move_append(ctors, other.ctors);
+    move_append(params, other.params);
+    move_append(signatures, other.signatures);
+  }
+  // sort by source position and drop copies of the same decl added by other translation units,
+  // output is then independent of translation unit order and thread count
+  inline void canonicalize() {
+    canonicalize_decls(records);
+    canonicalize_decls(functions);
+    canonicalize_decls(enums);
+    _compact();
+  }
+  // schema drops keys, null writes everything
+  inline std::string serialize(const OutputSchema *schema = nullptr) const {
     std::string str;
     llvm::raw_string_ostream output(str);
     llvm::json::OStream stream(output);
+    DatabaseStream database_stream(stream, schema, const_cast<Database &>(*this));
 
-    serde(stream, "", const_cast<Database &>(*this));
+    serde(database_stream, "", const_cast<Database &>(*this));
 
     return str;
   }
+  inline llvm::json::Value to_json(const OutputSchema *schema = nullptr) const {
+    JsonValueBuilder builder;
+    DatabaseStream database_stream(builder, schema, const_cast<Database &>(*this));
+    serde(database_stream, "", const_cast<Database &>(*this));
+    return builder.take();
+  }
+  // read back what to_json or serialize wrote without schema
+  static inline Database from_json(const llvm::json::Value &value) {
+    Database db;
+    JsonValueReader reader(value);
+    DatabaseStream database_stream(reader, nullptr, db);
+    serde(database_stream, "", db);
+    return db;
+  }
+
+private:
+  template <typename T>
+  static llvm::ArrayRef<T> _rows(const std::vector<T> &table, Range range) {
+    return llvm::ArrayRef<T>(table).slice(range.begin, range.count);
+  }
+
+  // shift links of all rows, used before this is appended after tables of the given sizes
+  inline void _rebase(size_t field_offset, size_t method_offset, size_t ctor_offset, size_t param_offset, size_t signature_offset) {
+    for (auto &record : records) {
+      record.fields.begin += field_offset;
+      record.methods.begin += method_offset;
+      record.ctors.begin += ctor_offset;
+    }
+    for (auto *table : {&functions, &methods, &signatures}) {
+      for (auto &function : *table) {
+        function.parameters.begin += param_offset;
+      }
+    }
+    for (auto &ctor : ctors) {
+      ctor.parameters.begin += param_offset;
+    }
+    for (auto *table : {&fields, &params}) {
+      for (auto &field : *table) {
+        if (field.signature >= 0)
+          field.signature += signature_offset;
+      }
+    }
+  }
+
+  // move rows of range in from_table and the rows they link to out of from, into tables of this
+  template <typename T>
+  Range _take_rows(std::vector<T> &table, std::vector<T> &from_table, Range range, Database &from) {
+    std::vector<T> rows(std::make_move_iterator(from_table.begin() + range.begin),
+                        std::make_move_iterator(from_table.begin() + range.begin + range.count));
+    for (auto &row : rows) {
+      if constexpr (std::is_same_v<T, Field>) {
+        if (row.signature < 0)
+          continue;
+        auto signature = std::move(from.signatures[row.signature]);
+        signature.parameters = _take_rows(params, from.params, signature.parameters, from);
+        row.signature = signatures.size();
+        signatures.push_back(std::move(signature));
+      } else {
+        row.parameters = _take_rows(params, from.params, row.parameters, from);
+      }
+    }
+    return add_rows(table, std::move(rows));
+  }
+
+  // rebuild tables in order of decls, rows of decls dropped by canonicalize go away
+  inline void _compact() {
+    Database compacted;
+    move_append(compacted.records, records);
+    move_append(compacted.functions, functions);
+    move_append(compacted.enums, enums);
+    for (auto &record : compacted.records) {
+      record.fields = compacted._take_rows(compacted.fields, fields, record.fields, *this);
+      record.methods = compacted._take_rows(compacted.methods, methods, record.methods, *this);
+      record.ctors = compacted._take_rows(compacted.ctors, ctors, record.ctors, *this);
+    }
+    for (auto &function : compacted.functions) {
+      function.parameters = compacted._take_rows(compacted.params, params, function.parameters, *this);
+    }
+    *this = std::move(compacted);
+  }
 };
 META_SERDE_FUNCTION(Database) {
   serde_obj(s, key, [&] {
@@ -252,19 +552,6 @@ META_SERDE_FUNCTION(Database) {
 
 // some declarations
 namespace meta {
-struct Identity {
-  std::string fileName;
-  unsigned line;
-  bool operator==(const Identity &other) const {
-    return fileName == other.fileName && line == other.line;
-  }
-};
-
-struct IdentityHash {
-  size_t operator()(const Identity &id) const {
-    return std::hash<std::string>{}(id.fileName) + id.line;
-  }
-};
-
-using FileDataMap = std::unordered_map<std::string, Database>;
+// sorted by relative path, so output order doesn't depend on hashing
+using FileDataMap = std::map<std::string, Database>;
 } // namespace meta
\ No newline at end of file
@@ -1,16 +1,271 @@
 #pragma once
+#include "OutputSchema.h"
 #include "llvm/Support/JSON.h"
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
 
-// serde macro
-#define META_SERDE(__F) serde(s, #__F, v.__F);
-#define META_SERDE_N(__F, __N) serde(s, __N, v.__F);
-#define META_SERDE_FUNCTION(__Type) inline void serde(llvm::json::OStream &s, std::string_view key, __Type &v)
-#define META_SERDE_FWD(__Type) void serde(llvm::json::OStream &s, std::string_view key, __Type &v);
+// serde macro, Stream is llvm::json::OStream, meta::JsonValueBuilder, meta::JsonValueReader or meta::SchemaStream over them
+#define META_SERDE(__F) META_SERDE_N(__F, #__F)
+#define META_SERDE_N(__F, __N)                                \
+  if (serde_has_key<std::remove_cvref_t<decltype(v)>>(s, __N)) \
+    serde(s, __N, v.__F);
+#define META_SERDE_FUNCTION(__Type)                                              \
+  template <>                                                                    \
+  struct SerdeTypeName<__Type> {                                                 \
+    static constexpr std::string_view value = #__Type;                           \
+  };                                                                             \
+  template <typename Stream>                                                     \
+  inline void serde(Stream &s, std::string_view key, __Type &v)
+#define META_SERDE_FWD(__Type) \
+  template <typename Stream>   \
+  void serde(Stream &s, std::string_view key, __Type &v);
 
 namespace meta {
+// name of a struct serialized with META_SERDE_FUNCTION, used as struct name in OutputSchema
+template <typename T>
+struct SerdeTypeName;
+
+// reading streams fill values through the same serde functions
+template <typename Stream>
+constexpr bool serde_is_reader() {
+  if constexpr (requires { Stream::is_reader; }) {
+    return Stream::is_reader;
+  } else {
+    return false;
+  }
+}
+
+// stream wrapper that carries an OutputSchema, keys dropped by it are not written
+template <typename Inner>
+class SchemaStream {
+public:
+  static constexpr bool is_reader = serde_is_reader<Inner>();
+
+  SchemaStream(Inner &inner, const OutputSchema *schema)
+      : _inner(inner), _schema(schema) {}
+
+  void value(llvm::json::Value v) { _inner.value(std::move(v)); }
+  void attribute(llvm::StringRef key, llvm::json::Value v) { _inner.attribute(key, std::move(v)); }
+
+  template <typename T>
+  void read(llvm::StringRef key, T &v) { _inner.read(key, v); }
+  size_t array_size(llvm::StringRef key) { return _inner.array_size(key); }
+  std::vector<std::string> object_keys(llvm::StringRef key) { return _inner.object_keys(key); }
+
+  template <typename Func>
+  void object(Func &&func) { _inner.object(func); }
+  template <typename Func>
+  void array(Func &&func) { _inner.array(func); }
+  template <typename Func>
+  void attributeObject(llvm::StringRef key, Func &&func) { _inner.attributeObject(key, func); }
+  template <typename Func>
+  void attributeArray(llvm::StringRef key, Func &&func) { _inner.attributeArray(key, func); }
+
+  const OutputSchema *schema() const { return _schema; }
+  // keys asked through serde_has_key, passed to an inner stream collecting them
+  void on_key(std::string_view type, std::string_view key) {
+    if constexpr (requires { _inner.on_key(type, key); })
+      _inner.on_key(type, key);
+  }
+
+private:
+  Inner &_inner;
+  const OutputSchema *_schema;
+};
+
+template <typename T, typename Stream>
+bool serde_has_key(Stream &s, std::string_view key) {
+  if constexpr (requires { s.schema(); }) {
+    s.on_key(SerdeTypeName<T>::value, key);
+    auto schema = s.schema();
+    return !schema || schema->has(SerdeTypeName<T>::value, key);
+  } else {
+    return true;
+  }
+}
+
+// same interface as llvm::json::OStream, writes nothing but collects the keys of every struct serialized through
+// a SchemaStream over it, keys behind a condition are only seen if the value meets it
+class SerdeKeyCollector {
+public:
+  void value(llvm::json::Value) {}
+  void attribute(llvm::StringRef, llvm::json::Value) {}
+
+  template <typename Func>
+  void object(Func &&func) { func(); }
+  template <typename Func>
+  void array(Func &&func) { func(); }
+  template <typename Func>
+  void attributeObject(llvm::StringRef, Func &&func) { func(); }
+  template <typename Func>
+  void attributeArray(llvm::StringRef, Func &&func) { func(); }
+
+  void on_key(std::string_view type, std::string_view key) { _keys[std::string(type)].insert(std::string(key)); }
+  // struct name -> keys
+  std::map<std::string, std::set<std::string>> take() { return std::move(_keys); }
+
+private:
+  std::map<std::string, std::set<std::string>> _keys;
+};
+
+// same interface as llvm::json::OStream, but builds llvm::json::Value in memory
+class JsonValueBuilder {
+public:
+  void value(llvm::json::Value v) { _emit(std::move(v)); }
+  void attribute(llvm::StringRef key, llvm::json::Value v) { _emit_attribute(key, std::move(v)); }
+
+  template <typename Func>
+  void object(Func &&func) { _nested(_emit(llvm::json::Object{}), func); }
+  template <typename Func>
+  void array(Func &&func) { _nested(_emit(llvm::json::Array{}), func); }
+  template <typename Func>
+  void attributeObject(llvm::StringRef key, Func &&func) { _nested(_emit_attribute(key, llvm::json::Object{}), func); }
+  template <typename Func>
+  void attributeArray(llvm::StringRef key, Func &&func) { _nested(_emit_attribute(key, llvm::json::Array{}), func); }
+
+  llvm::json::Value take() { return std::move(_root); }
+
+private:
+  llvm::json::Value *_emit(llvm::json::Value v) {
+    if (_stack.empty()) {
+      _root = std::move(v);
+      return &_root;
+    }
+    auto array = _stack.back()->getAsArray();
+    assert(array && "json value must be in array");
+    array->push_back(std::move(v));
+    return &array->back();
+  }
+  llvm::json::Value *_emit_attribute(llvm::StringRef key, llvm::json::Value v) {
+    auto object = _stack.back()->getAsObject();
+    assert(object && "json attribute must be in object");
+    // owned key, runtime keys of maps must not borrow memory from the serialized data
+    auto &slot = (*object)[llvm::json::ObjectKey(key.str())];
+    slot = std::move(v);
+    return &slot;
+  }
+  template <typename Func>
+  void _nested(llvm::json::Value *target, Func &&func) {
+    _stack.push_back(target);
+    func();
+    _stack.pop_back();
+  }
+
+  llvm::json::Value _root = nullptr;
+  std::vector<llvm::json::Value *> _stack;
+};
+
+// reads llvm::json::Value back with the interface of llvm::json::OStream, missing or mistyped values keep
+// their defaults, an empty key takes the next element of the current array
+class JsonValueReader {
+public:
+  static constexpr bool is_reader = true;
+
+  explicit JsonValueReader(const llvm::json::Value &root)
+      : _root(root) {}
+
+  template <typename Func>
+  void object(Func &&func) { _nested(_take(""), func); }
+  template <typename Func>
+  void array(Func &&func) { _nested(_take(""), func); }
+  template <typename Func>
+  void attributeObject(llvm::StringRef key, Func &&func) { _nested(_take(key), func); }
+  template <typename Func>
+  void attributeArray(llvm::StringRef key, Func &&func) { _nested(_take(key), func); }
+
+  template <typename T>
+  void read(llvm::StringRef key, T &v) {
+    if (auto value = _take(key))
+      _assign(*value, v);
+  }
+  // peek before attributeArray or attributeObject to size the container
+  size_t array_size(llvm::StringRef key) {
+    auto value = _peek(key);
+    auto array = value ? value->getAsArray() : nullptr;
+    return array ? array->size() : 0;
+  }
+  std::vector<std::string> object_keys(llvm::StringRef key) {
+    std::vector<std::string> keys;
+    auto value = _peek(key);
+    if (auto object = value ? value->getAsObject() : nullptr) {
+      for (auto &[k, v] : *object) {
+        keys.push_back(k.str());
+      }
+    }
+    return keys;
+  }
+
+private:
+  struct Frame {
+    const llvm::json::Value *value;
+    size_t next_element = 0;
+  };
+
+  const llvm::json::Value *_peek(llvm::StringRef key) {
+    if (_stack.empty())
+      return _root_taken ? nullptr : &_root;
+    auto &frame = _stack.back();
+    if (key.empty()) {
+      auto array = frame.value->getAsArray();
+      return array && frame.next_element < array->size() ? &(*array)[frame.next_element] : nullptr;
+    }
+    auto object = frame.value->getAsObject();
+    return object ? object->get(key) : nullptr;
+  }
+  const llvm::json::Value *_take(llvm::StringRef key) {
+    auto value = _peek(key);
+    if (_stack.empty())
+      _root_taken = true;
+    else if (key.empty())
+      ++_stack.back().next_element;
+    return value;
+  }
+  template <typename Func>
+  void _nested(const llvm::json::Value *value, Func &&func) {
+    if (!value)
+      return;
+    _stack.push_back({value});
+    func();
+    _stack.pop_back();
+  }
+
+  static void _assign(const llvm::json::Value &value, bool &v) {
+    if (auto b = value.getAsBoolean())
+      v = *b;
+  }
+  static void _assign(const llvm::json::Value &value, std::string &v) {
+    if (auto str = value.getAsString())
+      v = str->str();
+  }
+  static void _assign(const llvm::json::Value &value, llvm::json::Object &v) {
+    if (auto object = value.getAsObject())
+      v = *object;
+  }
+  template <typename T>
+  static void _assign(const llvm::json::Value &value, T &v) {
+    // integers written as uint64 above int64 range are read back with the same bits
+    if constexpr (std::is_floating_point_v<T>) {
+      if (auto number = value.getAsNumber())
+        v = T(*number);
+    } else if (auto integer = value.getAsInteger()) {
+      v = T(*integer);
+    } else if (auto unsigned_integer = value.getAsUINT64()) {
+      v = T(*unsigned_integer);
+    }
+  }
+
+  const llvm::json::Value &_root;
+  bool _root_taken = false;
+  std::vector<Frame> _stack;
+};
+
 // serde helper function
-template <typename Func>
-void serde_obj(llvm::json::OStream &s, std::string_view key, Func &&func) {
+template <typename Stream, typename Func>
+void serde_obj(Stream &s, std::string_view key, Func &&func) {
   if (key.empty()) {
     s.object(func);
   } else {
@@ -25,19 +280,36 @@ concept SerdePrimitiveType =
     std::is_floating_point_v<T> ||
     std::is_same_v<T, bool> ||
     std::is_same_v<T, std::string>;
-template <SerdePrimitiveType T>
-void serde(llvm::json::OStream &s, std::string_view key, T &v) {
-  if (key.empty()) {
+template <typename Stream, SerdePrimitiveType T>
+void serde(Stream &s, std::string_view key, T &v) {
+  if constexpr (serde_is_reader<Stream>()) {
+    s.read(key, v);
+  } else if (key.empty()) {
     s.value(v);
   } else {
     s.attribute(key, v);
   }
 }
 
+// serde json object, already structured data such as parsed annotations
+template <typename Stream>
+void serde(Stream &s, std::string_view key, llvm::json::Object &v) {
+  if constexpr (serde_is_reader<Stream>()) {
+    s.read(key, v);
+  } else if (key.empty()) {
+    s.value(llvm::json::Object(v));
+  } else {
+    s.attribute(key, llvm::json::Object(v));
+  }
+}
+
 // serde vector type
-template <typename T>
-void serde(llvm::json::OStream &s, std::string_view key, std::vector<T> &v) {
+template <typename Stream, typename T>
+void serde(Stream &s, std::string_view key, std::vector<T> &v) {
   assert(!key.empty() && "json array cannot naested");
+  if constexpr (serde_is_reader<Stream>()) {
+    v.resize(s.array_size(key));
+  }
   s.attributeArray(key, [&] {
     for (auto &i : v) {
       serde(s, "", i);
@@ -45,13 +317,36 @@ void serde(llvm::json::OStream &s, std::string_view key, std::vector<T> &v) {
   });
 }
 
-// serde string map
-template <typename T>
-void serde(llvm::json::OStream &s, std::string_view key, std::unordered_map<std::string, T> &v) {
+// serde string map, keys are written in sorted order
+template <typename Stream, typename T>
+void serde(Stream &s, std::string_view key, std::map<std::string, T> &v) {
+  if constexpr (serde_is_reader<Stream>()) {
+    for (auto &k : s.object_keys(key)) {
+      v[k];
+    }
+  }
   serde_obj(s, key, [&] {
     for (auto &[k, i] : v) {
       serde(s, k, i);
     }
   });
 }
-} // namespace meta
\ No newline at end of file
+template <typename Stream, typename T>
+void serde(Stream &s, std::string_view key, std::unordered_map<std::string, T> &v) {
+  if constexpr (serde_is_reader<Stream>()) {
+    for (auto &k : s.object_keys(key)) {
+      v[k];
+    }
+  }
+  std::vector<std::pair<const std::string, T> *> items;
+  for (auto &item : v) {
+    items.push_back(&item);
+  }
+  std::sort(items.begin(), items.end(), [](auto a, auto b) { return a->first < b->first; });
+  serde_obj(s, key, [&] {
+    for (auto item : items) {
+      serde(s, item->first, item->second);
+    }
+  });
+}
+} // namespace meta
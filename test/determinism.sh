@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+# runs meta on the determinism fixture repeatedly, with different thread counts and in worker processes,
+# every run must write byte-identical meta files, caches, traces and parse times of a run are not compared
+# usage: determinism.sh <meta executable>
+set -euo pipefail
+
+meta=${1:?usage: determinism.sh <meta executable>}
+fixture=$(cd "$(dirname "$0")/determinism" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# translation units in both orders, so the first translation unit reaching a header differs
+run() {
+  local name=$1
+  shift
+  "$meta" --root="$fixture" --output="$work/$name" "$@" -- -std=c++20 -I"$fixture" >/dev/null
+  (cd "$work/$name" && find . -name '*.meta' | LC_ALL=C sort) >"$work/$name.list"
+}
+run first --jobs=1 "$fixture/shapes.cpp" "$fixture/scene.cpp" "$fixture/app.cpp"
+run repeat --jobs=1 "$fixture/shapes.cpp" "$fixture/scene.cpp" "$fixture/app.cpp"
+run jobs --jobs=8 "$fixture/shapes.cpp" "$fixture/scene.cpp" "$fixture/app.cpp"
+run reversed --jobs=8 "$fixture/app.cpp" "$fixture/scene.cpp" "$fixture/shapes.cpp"
+run pipeline --pipeline --parse-jobs=3 "$fixture/app.cpp" "$fixture/scene.cpp" "$fixture/shapes.cpp"
+run workers --workers=2 "$fixture/shapes.cpp" "$fixture/scene.cpp" "$fixture/app.cpp"
+
+if [ ! -s "$work/first.list" ]; then
+  echo "no meta files written" >&2
+  exit 1
+fi
+status=0
+for name in repeat jobs reversed pipeline workers; do
+  differs=0
+  diff "$work/first.list" "$work/$name.list" >&2 || differs=1
+  while read -r file; do
+    if [ -f "$work/$name/$file" ] && ! cmp -s "$work/first/$file" "$work/$name/$file"; then
+      echo "differs: $file" >&2
+      differs=1
+    fi
+  done <"$work/first.list"
+  if [ $differs -ne 0 ]; then
+    echo "meta files of run '$name' differ from the first run" >&2
+    status=1
+  fi
+done
+exit $status
@@ -0,0 +1,6 @@
+#include "shapes.h"
+#include "scene.h"
+
+namespace fixture {
+REFLECT int run_app(Scene &scene) { return scene.find_layer(0) ? 0 : 1; }
+} // namespace fixture
@@ -0,0 +1,4 @@
+#pragma once
+
+#define REFLECT __attribute__((annotate("__reflect__")))
+#define ATTR(text) __attribute__((annotate(text)))
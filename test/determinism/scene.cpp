@@ -0,0 +1,9 @@
+#include "scene.h"
+#include "shapes.h"
+
+namespace fixture {
+float Circle::area() const { return 3.14159f * radius * radius; }
+void Scene::add(const Circle &) {}
+Scene::Layer *Scene::find_layer(int depth) { return depth < 4 ? &layers[depth] : nullptr; }
+Scene *load_scene(const char *) { return nullptr; }
+} // namespace fixture
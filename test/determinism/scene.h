@@ -0,0 +1,26 @@
+#pragma once
+#include "shapes.h"
+
+namespace fixture {
+struct REFLECT Circle : Shape {
+  float radius ATTR("min=0") = 1;
+
+  float area() const override;
+};
+
+struct REFLECT Scene {
+  struct REFLECT Layer {
+    int depth;
+    bool visible ATTR("default=true");
+  };
+
+  Layer layers[4];
+  Circle *circles;
+  unsigned circle_count;
+
+  void add(const Circle &circle);
+  Layer *find_layer(int depth);
+};
+
+REFLECT Scene *load_scene(const char *path);
+} // namespace fixture
@@ -0,0 +1,9 @@
+#include "shapes.h"
+
+namespace fixture {
+float Point::length() const { return x * x + y * y; }
+Shape::Shape() : kind(ShapeKind::Circle), points{} {}
+Shape::~Shape() {}
+float Shape::area() const { return 0; }
+float distance(const Point &a, const Point &b) { return Point{a.x - b.x, a.y - b.y}.length(); }
+} // namespace fixture
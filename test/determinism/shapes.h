@@ -0,0 +1,29 @@
+#pragma once
+#include "reflect.h"
+
+namespace fixture {
+enum class REFLECT ShapeKind : unsigned {
+  Circle,
+  Rect = 4,
+  Polygon,
+};
+
+struct REFLECT ATTR("category=geometry") Point {
+  float x = 0;
+  float y = 0;
+
+  float length() const;
+};
+
+struct REFLECT Shape {
+  ShapeKind kind;
+  Point origin ATTR("serialize");
+  unsigned points[8];
+
+  Shape();
+  virtual ~Shape();
+  virtual float area() const;
+};
+
+REFLECT float distance(const Point &a, const Point &b);
+} // namespace fixture
@@ -0,0 +1,366 @@
+#include "HeaderSchedule.h"
+#include "MetaArchive.h"
+#include "OptionsParser.h"
+#include "OutputSchema.h"
+#include "Prescan.h"
+#include "Reflector.h"
+#include "TUSchedule.h"
+#include "TUSelection.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+// checks of the reflector library, run by ctest, fails if any check fails
+static int failed_checks = 0;
+#define META_CHECK(__Cond)                                                              \
+  do {                                                                                  \
+    if (!(__Cond)) {                                                                    \
+      llvm::errs() << __FILE__ << ":" << __LINE__ << ": check failed: " #__Cond "\n"; \
+      ++failed_checks;                                                                  \
+    }                                                                                   \
+  } while (false)
+
+// temporary file removed at scope exit
+struct TempFile {
+  llvm::SmallString<128> path;
+
+  explicit TempFile(llvm::StringRef suffix) {
+    if (auto ec = llvm::sys::fs::createTemporaryFile("meta-test", suffix, path))
+      llvm::errs() << "cannot create temporary file: " << ec.message() << "\n";
+  }
+  ~TempFile() { llvm::sys::fs::remove(path); }
+};
+
+// temporary directory with its files removed at scope exit
+struct TempDir {
+  llvm::SmallString<128> path;
+
+  TempDir() {
+    if (auto ec = llvm::sys::fs::createUniqueDirectory("meta-test", path))
+      llvm::errs() << "cannot create temporary directory: " << ec.message() << "\n";
+  }
+  ~TempDir() { llvm::sys::fs::remove_directories(path); }
+
+  std::string write(llvm::StringRef name, llvm::StringRef content) {
+    llvm::SmallString<128> file_path(path);
+    llvm::sys::path::append(file_path, name);
+    std::error_code ec;
+    llvm::raw_fd_ostream os(file_path, ec);
+    os << content;
+    return file_path.str().str();
+  }
+};
+
+static void test_archive_round_trip() {
+  for (auto compression : {meta::ArchiveCompression::None, meta::ArchiveCompression::Zstd}) {
+    TempFile file("metaarc");
+    std::string large(4096, 'x');
+    meta::MetaArchiveWriter writer(compression);
+    writer.add("core/object.h.meta", "{\"records\":[]}");
+    writer.add("core/large.h.meta", large);
+    writer.add("empty.h.meta", "");
+    if (auto err = writer.write(file.path)) {
+      llvm::errs() << llvm::toString(std::move(err)) << "\n";
+      META_CHECK(false);
+      continue;
+    }
+
+    auto reader = meta::MetaArchiveReader::open(file.path);
+    META_CHECK(bool(reader));
+    if (!reader) {
+      llvm::consumeError(reader.takeError());
+      continue;
+    }
+    META_CHECK(reader->names().size() == 3);
+    META_CHECK(reader->contains("core/object.h.meta"));
+    META_CHECK(!reader->contains("/core/object.h.meta"));
+    auto object = reader->read("core/object.h.meta");
+    META_CHECK(object && *object == "{\"records\":[]}");
+    auto large_read = reader->read("core/large.h.meta");
+    META_CHECK(large_read && *large_read == large);
+    auto empty = reader->read("empty.h.meta");
+    META_CHECK(empty && empty->empty());
+    auto missing = reader->read("missing.h.meta");
+    META_CHECK(!missing);
+    if (!missing)
+      llvm::consumeError(missing.takeError());
+  }
+}
+
+static void test_schema_keys() {
+  auto schema = meta::OutputSchema::parse(R"({"Field": ["name", "functor"], "EnumValue": ["value"], "PerfectHash": []})",
+                                          "schema");
+  META_CHECK(bool(schema));
+  if (schema) {
+    META_CHECK(schema->has("Field", "name"));
+    META_CHECK(!schema->has("Field", "type"));
+    META_CHECK(schema->has("Record", "fields"));
+  } else {
+    llvm::consumeError(schema.takeError());
+  }
+
+  for (auto json : {R"({"Feild": ["name"]})", R"({"Field": ["nmae"]})", R"({"Record": ["values"]})"}) {
+    auto invalid = meta::OutputSchema::parse(json, "schema");
+    META_CHECK(!invalid);
+    if (!invalid)
+      llvm::consumeError(invalid.takeError());
+  }
+}
+
+static bool contains_arg(const clang::tooling::CommandLineArguments &args, llvm::StringRef arg) {
+  return std::find(args.begin(), args.end(), arg) != args.end();
+}
+
+static void test_fast_parse_cl_warning_flags() {
+  auto adjuster = meta::getFastParseArgumentsAdjuster();
+  auto args = adjuster({"clang-cl", "/W4", "/w", "/w14996", "/wd4996", "/we4700", "/wo4100", "/winsysroot:C:/msvc",
+                        "/winsdkdir", "C:/sdk", "/Zi", "a.cpp"},
+                       "a.cpp");
+  for (auto stripped : {"/W4", "/w14996", "/wd4996", "/we4700", "/wo4100", "/Zi"})
+    META_CHECK(!contains_arg(args, stripped));
+  for (auto kept : {"/winsysroot:C:/msvc", "/winsdkdir", "C:/sdk", "a.cpp"})
+    META_CHECK(contains_arg(args, kept));
+}
+
+static void test_fast_parse_flags_before_double_dash() {
+  auto adjuster = meta::getFastParseArgumentsAdjuster();
+  auto args = adjuster({"clang++", "-std=c++17", "-Wall", "--", "a.cpp"}, "a.cpp");
+  clang::tooling::CommandLineArguments expected{"clang++", "-std=c++17", "-w", "-fdelayed-template-parsing", "--", "a.cpp"};
+  META_CHECK(args == expected);
+}
+
+// -include-pch loads a precompiled header, only -include forces a file into the translation unit
+static void test_prescan_forced_includes() {
+  TempDir dir;
+  auto main_file = dir.write("main.cpp", "int main() { return 0; }\n");
+  auto forced = dir.write("forced.h", "struct __attribute__((annotate(\"__reflect__\"))) Forced {};\n");
+  dir.write("joined.h", "#pragma once\n");
+  for (auto pch_args : {std::vector<std::string>{"-include-pch", "prefix.pch"}, std::vector<std::string>{"-include-pchprefix.pch"}}) {
+    std::vector<std::string> command_line{"clang++"};
+    command_line.insert(command_line.end(), pch_args.begin(), pch_args.end());
+    command_line.insert(command_line.end(), {"-include", "forced.h", "-includejoined.h", main_file});
+    clang::tooling::CompileCommand command(dir.path, main_file, command_line, "");
+
+    meta::Prescanner prescanner(dir.path.str().str(), {"__reflect__"});
+    auto scan = prescanner.scan_tu(command);
+    META_CHECK(scan.is_complete);
+    META_CHECK(scan.has_marker);
+    META_CHECK(scan.files.size() == 3);
+    for (auto &file : scan.files)
+      META_CHECK(!llvm::StringRef(file).contains("pch"));
+  }
+}
+
+using Headers = std::vector<std::string>;
+
+// a header is released once no unfinished translation unit is predicted to include it
+static void test_header_schedule_early_release() {
+  meta::HeaderSchedule schedule;
+  schedule.expect("a.cpp", {"/x.h", "/y.h"}, true);
+  schedule.expect("b.cpp", {"/y.h"}, true);
+  schedule.produce("/x.h");
+  schedule.produce("/y.h");
+  META_CHECK(schedule.finish("a.cpp") == Headers{"/x.h"});
+  META_CHECK(schedule.is_released("/x.h"));
+  META_CHECK(!schedule.is_released("/y.h"));
+  META_CHECK(schedule.finish("b.cpp") == Headers{"/y.h"});
+  META_CHECK(schedule.release_remaining().empty());
+}
+
+// a translation unit with includes the scan could not follow holds back every header until it finished
+static void test_header_schedule_incomplete_tu() {
+  meta::HeaderSchedule schedule;
+  schedule.expect("a.cpp", {"/x.h"}, true);
+  schedule.expect("b.cpp", {}, false);
+  schedule.produce("/x.h");
+  META_CHECK(schedule.finish("a.cpp").empty());
+  META_CHECK(!schedule.is_released("/x.h"));
+  META_CHECK(schedule.finish("b.cpp") == Headers{"/x.h"});
+}
+
+// decls of a released header from an include the scan did not predict are late, the header is not released again
+static void test_header_schedule_mispredicted_include() {
+  meta::HeaderSchedule schedule;
+  schedule.expect("a.cpp", {"/x.h"}, true);
+  schedule.expect("b.cpp", {"/y.h"}, true);
+  schedule.produce("/x.h");
+  META_CHECK(schedule.finish("a.cpp") == Headers{"/x.h"});
+
+  // b.cpp really includes x.h too
+  META_CHECK(schedule.is_released("/x.h"));
+  schedule.produce("/x.h");
+  schedule.produce("/y.h");
+  META_CHECK(schedule.finish("b.cpp") == Headers{"/y.h"});
+  META_CHECK(schedule.release_remaining().empty());
+}
+
+// covering fixup parses after every scheduled translation unit finished, new headers come out of release_remaining
+static void test_header_schedule_covering_fixup() {
+  meta::HeaderSchedule schedule;
+  schedule.expect("a.cpp", {"/x.h"}, true);
+  schedule.produce("/x.h");
+  META_CHECK(schedule.finish("a.cpp") == Headers{"/x.h"});
+
+  schedule.produce("/x.h");
+  schedule.produce("/z.h");
+  schedule.produce("/w.h");
+  META_CHECK(schedule.release_remaining() == (Headers{"/w.h", "/z.h"}));
+  META_CHECK(schedule.is_released("/z.h"));
+  META_CHECK(schedule.release_remaining().empty());
+}
+
+static meta::TUCoverage coverage(std::string tu, std::vector<std::string> headers, uint64_t cost,
+                                 bool must_select = false) {
+  meta::TUCoverage result;
+  result.tu = std::move(tu);
+  result.headers = std::move(headers);
+  result.cost = cost;
+  result.must_select = must_select;
+  return result;
+}
+
+// forced translation units come first and cover their headers, translation units without gain are never picked
+static void test_select_covering_must_select() {
+  std::vector<meta::TUCoverage> candidates{
+      coverage("forced.cpp", {"/y.h"}, 100, true),
+      coverage("empty_forced.cpp", {}, 0, true),
+      coverage("only_y.cpp", {"/y.h"}, 0),
+      coverage("nothing.cpp", {}, 0),
+      coverage("x.cpp", {"/x.h", "/y.h"}, 5),
+  };
+  META_CHECK(meta::select_covering_tus(candidates) == (std::vector<size_t>{0, 1, 4}));
+  META_CHECK(meta::select_covering_tus({}).empty());
+}
+
+// a stale score is re-queued with the gain left, a translation unit whose gain dropped to zero is skipped
+static void test_select_covering_lazy_greedy() {
+  std::vector<meta::TUCoverage> candidates{
+      coverage("p.cpp", {"/a.h", "/b.h", "/c.h"}, 2), // 1.0, then 1/3 after q.cpp, then nothing left
+      coverage("q.cpp", {"/a.h", "/b.h", "/d.h"}, 1), // 1.5
+      coverage("r.cpp", {"/d.h"}, 1),                 // 0.5, covered by q.cpp
+      coverage("s.cpp", {"/c.h", "/e.h"}, 3),         // 0.5, beats the re-queued p.cpp
+  };
+  META_CHECK(meta::select_covering_tus(candidates) == (std::vector<size_t>{1, 3}));
+}
+
+using Batches = std::vector<std::vector<std::string>>;
+
+// translation units without history cost as much as the most expensive known one, or 1 without any history
+static void test_schedule_without_history() {
+  meta::TUCostHistory empty;
+  META_CHECK(empty.cost("/proj/a.cpp") == 1);
+  META_CHECK(meta::schedule_batches({"/proj/a.cpp", "/proj/b.cpp", "/proj/c.cpp", "/proj/d.cpp"}, empty, 2) ==
+             (Batches{{"/proj/a.cpp", "/proj/b.cpp"}, {"/proj/c.cpp", "/proj/d.cpp"}}));
+  META_CHECK(meta::schedule_batches({"/proj/a.cpp", "/proj/b.cpp"}, empty, 8) ==
+             (Batches{{"/proj/a.cpp"}, {"/proj/b.cpp"}}));
+  META_CHECK(meta::schedule_batches({"/proj/a.cpp", "/proj/b.cpp"}, empty, 0) ==
+             (Batches{{"/proj/a.cpp", "/proj/b.cpp"}}));
+  META_CHECK(meta::schedule_batches({}, empty, 4).empty());
+
+  meta::TUCostHistory history;
+  history.record("/proj/a.cpp", 100, {});
+  history.record("/proj/b.cpp", 10, {});
+  META_CHECK(history.cost("/proj/new.cpp") == 100);
+  META_CHECK(meta::order_longest_first({"/proj/b.cpp", "/proj/new.cpp", "/proj/a.cpp"}, history) ==
+             (std::vector<std::string>{"/proj/new.cpp", "/proj/a.cpp", "/proj/b.cpp"}));
+}
+
+// a batch is seeded with the most expensive translation unit left, takes the ones sharing most header bytes
+// until it holds its share of the total cost, batches are ordered longest first
+static void test_schedule_batches_share_headers() {
+  TempDir dir;
+  auto big = dir.write("big.h", std::string(1000, ' '));
+  auto small = dir.write("small.h", std::string(10, ' '));
+  meta::TUCostHistory history;
+  history.record("/proj/a.cpp", 40, {big});
+  history.record("/proj/b.cpp", 30, {small});
+  history.record("/proj/c.cpp", 20, {big});
+  history.record("/proj/d.cpp", 10, {small});
+  auto batches = meta::schedule_batches({"/proj/d.cpp", "/proj/c.cpp", "/proj/b.cpp", "/proj/a.cpp"}, history, 2);
+  META_CHECK(batches == (Batches{{"/proj/a.cpp", "/proj/c.cpp"}, {"/proj/b.cpp", "/proj/d.cpp"}}));
+
+  // a batch reaching its share exactly is closed
+  meta::TUCostHistory even;
+  for (auto tu : {"/proj/a.cpp", "/proj/b.cpp", "/proj/c.cpp", "/proj/d.cpp"})
+    even.record(tu, 25, {});
+  META_CHECK(meta::schedule_batches({"/proj/a.cpp", "/proj/b.cpp", "/proj/c.cpp", "/proj/d.cpp"}, even, 2) ==
+             (Batches{{"/proj/a.cpp", "/proj/b.cpp"}, {"/proj/c.cpp", "/proj/d.cpp"}}));
+}
+
+// attribute keys must stay valid once the translation unit and its AST are gone
+static void test_attributes_outlive_tu() {
+  TempDir dir;
+  dir.write("annotated.h", R"(
+#pragma once
+struct __attribute__((annotate("__reflect__"), annotate("category=ai, hidden"), annotate("range", 0, 100))) Agent {
+  int level __attribute__((annotate("min=1")));
+};
+)");
+  auto source = dir.write("annotated.cpp", "#include \"annotated.h\"\n");
+
+  clang::tooling::FixedCompilationDatabase compilations(dir.path, {"-std=c++20"});
+  meta::ReflectorOptions options;
+  options.root = dir.path.str().str();
+  meta::Reflector reflector(compilations, std::move(options));
+  std::string serialized;
+  {
+    auto result = reflector.reflect({source}, /*fast_parse=*/false, /*quiet=*/true);
+    META_CHECK(result.status == 0);
+    auto found = std::find_if(result.files.begin(), result.files.end(),
+                              [](auto &entry) { return llvm::StringRef(entry.first).ends_with("annotated.h"); });
+    META_CHECK(found != result.files.end());
+    if (found != result.files.end())
+      serialized = found->second.serialize();
+  }
+
+  auto json = llvm::json::parse(serialized);
+  META_CHECK(bool(json));
+  if (!json) {
+    llvm::consumeError(json.takeError());
+    return;
+  }
+  auto records = json->getAsObject() ? json->getAsObject()->getArray("records") : nullptr;
+  META_CHECK(records && records->size() == 1);
+  if (!records || records->empty())
+    return;
+  auto record = (*records)[0].getAsObject();
+  auto attributes = record ? record->getObject("attributes") : nullptr;
+  META_CHECK(attributes && attributes->getString("category") == llvm::StringRef("ai"));
+  META_CHECK(attributes && attributes->getBoolean("hidden") == true);
+  auto range = attributes ? attributes->getArray("range") : nullptr;
+  META_CHECK(range && range->size() == 2);
+  auto fields = record ? record->getArray("fields") : nullptr;
+  auto field = fields && fields->size() == 1 ? (*fields)[0].getAsObject() : nullptr;
+  auto field_attributes = field ? field->getObject("attributes") : nullptr;
+  META_CHECK(field_attributes && field_attributes->getInteger("min") == 1);
+}
+
+int main() {
+  std::vector<std::pair<const char *, std::function<void()>>> tests{
+      {"archive_round_trip", test_archive_round_trip},
+      {"schema_keys", test_schema_keys},
+      {"fast_parse_cl_warning_flags", test_fast_parse_cl_warning_flags},
+      {"fast_parse_flags_before_double_dash", test_fast_parse_flags_before_double_dash},
+      {"prescan_forced_includes", test_prescan_forced_includes},
+      {"header_schedule_early_release", test_header_schedule_early_release},
+      {"header_schedule_incomplete_tu", test_header_schedule_incomplete_tu},
+      {"header_schedule_mispredicted_include", test_header_schedule_mispredicted_include},
+      {"header_schedule_covering_fixup", test_header_schedule_covering_fixup},
+      {"select_covering_must_select", test_select_covering_must_select},
+      {"select_covering_lazy_greedy", test_select_covering_lazy_greedy},
+      {"schedule_without_history", test_schedule_without_history},
+      {"schedule_batches_share_headers", test_schedule_batches_share_headers},
+      {"attributes_outlive_tu", test_attributes_outlive_tu},
+  };
+  for (auto &[name, test] : tests) {
+    int before = failed_checks;
+    test();
+    llvm::outs() << (failed_checks == before ? "[pass] " : "[fail] ") << name << "\n";
+  }
+  return failed_checks == 0 ? 0 : 1;
+}
@@ -5,29 +5,48 @@ set_policy("build.ccache", false)
 
 if (is_os("windows")) then 
 
-target("meta")
+target("meta_reflector")
     set_runtimes("MD")  -- runtime depend on LLVM compiled version, official version is MT
-    set_kind("binary")
-    add_files("src/**.cpp")
+    set_kind("static")
+    add_files("src/**.cpp|main.cpp")
     add_cxflags("-Wno-c++11-narrowing", "-fno-rtti", {force = true, tools={"gcc", "clang"}})
     add_cxflags("/GR-", {force=true, tools={"clang_cl", "cl"}})
-    add_links("lib/**")
+    add_links("lib/**", {public = true})
     add_syslinks("Version", "ntdll", "Ws2_32", "advapi32", "Shcore", "user32", "shell32", "Ole32", {public = true})
-    add_includedirs("include")
+    add_includedirs("include", {public = true})
+    add_includedirs("src", {public = true})
+
+target("meta")
+    set_runtimes("MD")
+    set_kind("binary")
+    add_files("src/main.cpp")
+    add_deps("meta_reflector")
+    add_cxflags("-Wno-c++11-narrowing", "-fno-rtti", {force = true, tools={"gcc", "clang"}})
+    add_cxflags("/GR-", {force=true, tools={"clang_cl", "cl"}})
+
+target("meta_tests")
+    set_runtimes("MD")
+    set_kind("binary")
+    set_default(false)
+    add_files("test/*.cpp")
+    add_deps("meta_reflector")
+    add_cxflags("-Wno-c++11-narrowing", "-fno-rtti", {force = true, tools={"gcc", "clang"}})
+    add_cxflags("/GR-", {force=true, tools={"clang_cl", "cl"}})
 
 else
 
 add_requires("zstd")
-target("meta")
-    set_kind("binary")
-    add_files("**.cpp")
+target("meta_reflector")
+    set_kind("static")
+    add_files("src/**.cpp|main.cpp")
     add_cxflags("-Wno-c++11-narrowing")
     add_cxflags("-fno-rtti", {force=true, tools={"gcc", "clang"}})
     add_cxflags("/GR-", {force=true, tools={"clang_cl", "cl"}})
-    add_syslinks("pthread", "curses")
-    add_linkdirs("lib")
-    add_includedirs("include")
-    add_packages("zstd")
+    add_syslinks("pthread", "curses", {public = true})
+    add_linkdirs("lib", {public = true})
+    add_includedirs("include", {public = true})
+    add_includedirs("src", {public = true})
+    add_packages("zstd", {public = true})
     on_load(function (target, opt)
         local libs = {}
         local p = "lib/lib*.a"
@@ -36,7 +55,24 @@ target("meta")
             local matchname = string.match(basename, "lib(.*)$")
             table.insert(libs, matchname or basename)
         end
-        target:add("links", libs)
+        target:add("links", libs, {public = true})
     end)
+
+target("meta")
+    set_kind("binary")
+    add_files("src/main.cpp")
+    add_deps("meta_reflector")
+    add_cxflags("-Wno-c++11-narrowing")
+    add_cxflags("-fno-rtti", {force=true, tools={"gcc", "clang"}})
+    add_cxflags("/GR-", {force=true, tools={"clang_cl", "cl"}})
+
+target("meta_tests")
+    set_kind("binary")
+    set_default(false)
+    add_files("test/*.cpp")
+    add_deps("meta_reflector")
+    add_cxflags("-Wno-c++11-narrowing")
+    add_cxflags("-fno-rtti", {force=true, tools={"gcc", "clang"}})
+    add_cxflags("/GR-", {force=true, tools={"clang_cl", "cl"}})
     
 end